@@ -9,3 +9,20 @@ struct BBox {
     int class_id;          // Class identifier
     std::string label;     // Human-readable label
 };
+
+// Layout detector settings, fixed when the model is loaded
+struct DetectorOptions {
+    int input_size = 0;  // Square model input size; 0 = the model's declared size (1024 if dynamic)
+    bool int8 = false;   // Prefer the INT8 quantized export (yolo_layout[_<size>]_int8.onnx)
+    
+    // ONNX Runtime execution settings
+    int intra_op_threads = 0;          // 0 = min(4, cores)
+    int inter_op_threads = 0;          // 0 = ORT default; only used with parallel execution
+    bool parallel_execution = false;   // ORT_PARALLEL instead of ORT_SEQUENTIAL
+    bool allow_spinning = true;        // Idle ORT threads spin instead of sleeping
+    bool cpu_mem_arena = true;
+    
+    // Cache of ORT-optimized model graphs, so later starts skip graph optimization
+    bool optimized_model_cache = true;
+    std::string model_cache_dir;  // Empty = "ort_cache" next to the model
+};
@@ -0,0 +1,199 @@
+#include "directory_watcher.hpp"
+#include "pdf_processor.hpp"
+#include "utils.hpp"
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <vector>
+
+namespace {
+
+// Write end of the self-pipe that wakes the event loop on SIGTERM / SIGINT
+int g_signal_pipe = -1;
+
+void handle_stop_signal(int) {
+    if (g_signal_pipe >= 0) {
+        char byte = 1;
+        ssize_t ignored = write(g_signal_pipe, &byte, 1);
+        (void)ignored;
+    }
+}
+
+// Hidden files are skipped: uploaders commonly write to a dot-file and rename
+bool is_input_pdf(const std::string& name) {
+    if (name.empty() || name[0] == '.') return false;
+    return utils::ends_with(utils::to_lower(name), ".pdf");
+}
+
+std::string output_path_for(const WatchOptions& options, const std::string& pdf_path) {
+    std::string stem = std::filesystem::path(pdf_path).stem().string();
+    return (std::filesystem::path(options.output_dir) / (stem + "_headings.json")).string();
+}
+
+// Queues every PDF whose output is missing or older than the PDF
+void scan_input_dir(const WatchOptions& options, std::set<std::string>& pending) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(options.input_dir, ec)) {
+        if (!entry.is_regular_file(ec) || !is_input_pdf(entry.path().filename().string())) {
+            continue;
+        }
+        
+        std::string pdf_path = entry.path().string();
+        std::filesystem::path output = output_path_for(options, pdf_path);
+        std::error_code output_ec;
+        auto output_time = std::filesystem::last_write_time(output, output_ec);
+        if (output_ec || output_time < entry.last_write_time(ec)) {
+            pending.insert(pdf_path);
+        }
+    }
+    if (ec) {
+        std::cerr << "Error scanning " << options.input_dir << ": " << ec.message() << "\n";
+    }
+}
+
+// Reads all queued inotify events. Returns false if the watched directory went away.
+bool read_events(int inotify_fd, const WatchOptions& options, std::set<std::string>& pending, bool& rescan) {
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EINTR) continue;
+            return true;  // EAGAIN: drained
+        }
+        if (length == 0) return true;
+        
+        for (char* cursor = buffer; cursor < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(cursor);
+            cursor += sizeof(inotify_event) + event->len;
+            
+            if (event->mask & IN_Q_OVERFLOW) {
+                rescan = true;  // Events were dropped; fall back to a directory scan
+                continue;
+            }
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                return false;
+            }
+            if (event->len > 0 && is_input_pdf(event->name)) {
+                pending.insert((std::filesystem::path(options.input_dir) / event->name).string());
+            }
+        }
+    }
+}
+
+} // namespace
+
+int run_watch_mode(const WatchOptions& options, PDFProcessor& processor) {
+    if (!std::filesystem::is_directory(options.input_dir)) {
+        std::cerr << "Error: Watch directory not found: " << options.input_dir << "\n";
+        return 1;
+    }
+    utils::ensure_directory_exists(options.output_dir);
+    
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        std::cerr << "Error: inotify_init1: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    // Close-after-write and rename-into-place both mean a complete file
+    if (inotify_add_watch(inotify_fd, options.input_dir.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0) {
+        std::cerr << "Error: Cannot watch " << options.input_dir << ": " << std::strerror(errno) << "\n";
+        close(inotify_fd);
+        return 1;
+    }
+    
+    int signal_pipe[2];
+    if (pipe(signal_pipe) != 0) {
+        std::cerr << "Error: pipe: " << std::strerror(errno) << "\n";
+        close(inotify_fd);
+        return 1;
+    }
+    g_signal_pipe = signal_pipe[1];
+    
+    struct sigaction stop_action{};
+    stop_action.sa_handler = handle_stop_signal;
+    sigemptyset(&stop_action.sa_mask);
+    struct sigaction previous_term{}, previous_int{};
+    sigaction(SIGTERM, &stop_action, &previous_term);
+    sigaction(SIGINT, &stop_action, &previous_int);
+    
+    // The watch is in place before the scan, so a file arriving in between is
+    // seen by at least one of them
+    std::set<std::string> pending;
+    scan_input_dir(options, pending);
+    
+    std::cout << "👀 Watching " << options.input_dir << " -> " << options.output_dir
+              << " (" << pending.size() << " file(s) to catch up on)\n";
+    
+    int exit_code = 0;
+    int processed = 0;
+    pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {signal_pipe[0], POLLIN, 0}};
+    for (;;) {
+        int ready = poll(fds, 2, pending.empty() ? -1 : 0);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: poll: " << std::strerror(errno) << "\n";
+            exit_code = 1;
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            bool rescan = false;
+            if (!read_events(inotify_fd, options, pending, rescan)) {
+                std::cerr << "Error: Watch directory was removed or moved: " << options.input_dir << "\n";
+                exit_code = 1;
+                break;
+            }
+            if (rescan) {
+                scan_input_dir(options, pending);
+            }
+        }
+        if (pending.empty()) {
+            continue;
+        }
+        
+        // Everything that arrived so far goes out as one batch, so several new
+        // files share the workers
+        std::vector<BatchItem> items;
+        for (const auto& pdf_path : pending) {
+            items.push_back({pdf_path, output_path_for(options, pdf_path)});
+        }
+        pending.clear();
+        
+        try {
+            processor.process_batch(items, [&](size_t index, const ProcessingResult& result) {
+                processed++;
+                if (result.success) {
+                    std::cout << "✓ " << items[index].pdf_path << ": " << result.headings.size()
+                              << " heading(s) in " << result.processing_time_seconds << "s -> "
+                              << items[index].output_json << "\n";
+                } else {
+                    std::cerr << "✗ Failed to process " << items[index].pdf_path << ": "
+                              << result.error_message << "\n";
+                }
+            });
+        } catch (const std::exception& e) {
+            std::cerr << "✗ Batch processing failed: " << e.what() << "\n";
+        }
+    }
+    
+    sigaction(SIGTERM, &previous_term, nullptr);
+    sigaction(SIGINT, &previous_int, nullptr);
+    g_signal_pipe = -1;
+    close(signal_pipe[0]);
+    close(signal_pipe[1]);
+    close(inotify_fd);
+    
+    std::cout << "Stopped watching after " << processed << " file(s)\n";
+    return exit_code;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+class PDFProcessor;
+
+struct WatchOptions {
+    std::string input_dir = "/app/input";
+    std::string output_dir = "/app/output";
+};
+
+// Keeps the processor warm and processes PDFs as they appear in input_dir
+// (closed after writing or moved in, via inotify). PDFs already there without
+// an up-to-date <stem>_headings.json are processed first. Outputs are written
+// atomically. Runs until SIGTERM / SIGINT, finishing the files in progress.
+// Returns a process exit code.
+int run_watch_mode(const WatchOptions& options, PDFProcessor& processor);
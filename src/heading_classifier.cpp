@@ -1,4 +1,5 @@
 #include "heading_classifier.hpp"
+#include "model_registry.hpp"
 #include <algorithm>
 #include <iostream>
 #include <regex>
@@ -7,10 +8,10 @@ HeadingClassifier::HeadingClassifier() {
     initialize_pattern_matchers();
 }
 
-bool HeadingClassifier::initialize(const std::string& model_path) {
+bool HeadingClassifier::initialize(const std::string& model_path, const DetectorOptions& options) {
     try {
-        yolo_detector_ = std::make_unique<YOLOInference>();
-        initialized_ = yolo_detector_->initialize(model_path);
+        yolo_detector_ = ModelRegistry::instance().layout_detector(model_path, options);
+        initialized_ = yolo_detector_ != nullptr;
         
         if (initialized_) {
             std::cout << "HeadingClassifier initialized with YOLO model: " << model_path << std::endl;
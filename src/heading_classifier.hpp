@@ -26,8 +26,9 @@ public:
     HeadingClassifier();
     ~HeadingClassifier() = default;
     
-    // Initialization with YOLO model
-    bool initialize(const std::string& model_path = "models/yolo_layout");
+    // Initialization with YOLO model, shared through the model registry
+    bool initialize(const std::string& model_path = "models/yolo_layout",
+                    const DetectorOptions& options = DetectorOptions());
     
     // Main classification function
     HeadingLevel determine_heading_level(const std::string& text, 
@@ -38,12 +39,16 @@ public:
     // Layout detection integration with YOLO
     std::vector<LayoutRegion> detect_layout_regions(const cv::Mat& image);
     
+    // Bump whenever the classification rules change; cached results from an
+    // older version are not reused
+    static std::string version() { return "1"; }
+    
     // Configuration
     void set_document_context(const std::string& title, int total_pages);
     
 private:
-    // YOLO inference engine
-    std::unique_ptr<YOLOInference> yolo_detector_;
+    // YOLO inference engine (shared with other users of the same model)
+    std::shared_ptr<YOLOInference> yolo_detector_;
     bool initialized_ = false;
     
     // Rule-based classification
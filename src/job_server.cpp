@@ -0,0 +1,483 @@
+#include "job_server.hpp"
+#include "pdf_processor.hpp"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Write end of the self-pipe that wakes the accept loop on SIGTERM / SIGINT
+int g_signal_pipe = -1;
+
+void handle_stop_signal(int) {
+    if (g_signal_pipe >= 0) {
+        char byte = 1;
+        ssize_t ignored = write(g_signal_pipe, &byte, 1);
+        (void)ignored;
+    }
+}
+
+const char* const BUSY_ERROR = "Server busy, try again later";
+
+std::mutex& print_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+bool decode_base64(const std::string& input, std::string& output) {
+    static const auto table = [] {
+        std::vector<int> values(256, -1);
+        const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (size_t i = 0; i < alphabet.size(); ++i) {
+            values[static_cast<unsigned char>(alphabet[i])] = static_cast<int>(i);
+        }
+        return values;
+    }();
+    
+    output.clear();
+    output.reserve(input.size() / 4 * 3);
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (unsigned char c : input) {
+        if (c == '=') break;
+        if (std::isspace(c)) continue;
+        int value = table[c];
+        if (value < 0) return false;
+        buffer = (buffer << 6) | static_cast<uint32_t>(value);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            output.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+        }
+    }
+    return true;
+}
+
+// Uploaded PDF bytes, written to a temporary file for the length of one job
+class TempPdf {
+public:
+    explicit TempPdf(const std::string& bytes) {
+        std::string pattern = (std::filesystem::temp_directory_path() / "pdf_processor_XXXXXX.pdf").string();
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        int fd = mkstemps(name.data(), 4);
+        if (fd < 0) {
+            throw std::runtime_error(std::string("Cannot create temporary file: ") + std::strerror(errno));
+        }
+        path_ = name.data();
+        
+        size_t written = 0;
+        while (written < bytes.size()) {
+            ssize_t n = write(fd, bytes.data() + written, bytes.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                int error = errno;
+                close(fd);
+                unlink(path_.c_str());
+                throw std::runtime_error(std::string("Cannot write temporary file: ") + std::strerror(error));
+            }
+            written += static_cast<size_t>(n);
+        }
+        close(fd);
+    }
+    
+    ~TempPdf() { unlink(path_.c_str()); }
+    
+    TempPdf(const TempPdf&) = delete;
+    TempPdf& operator=(const TempPdf&) = delete;
+    
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+// Warm processors, one per concurrent job. Models are shared through the
+// model registry, so extra processors only add a MuPDF context and OCR engines.
+class ProcessorPool {
+public:
+    ProcessorPool(int size, const DetectorOptions& detector_options,
+                  const std::function<void(PDFProcessor&)>& configure) {
+        for (int i = 0; i < size; ++i) {
+            processors_.push_back(std::make_unique<PDFProcessor>(detector_options));
+            configure(*processors_.back());
+            free_.push_back(processors_.back().get());
+        }
+    }
+    
+    // Waits for a free processor; nullptr when max_queued jobs are already waiting
+    PDFProcessor* acquire(int max_queued) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.empty() && waiting_ >= max_queued) {
+            return nullptr;
+        }
+        waiting_++;
+        available_.wait(lock, [this] { return !free_.empty(); });
+        waiting_--;
+        PDFProcessor* processor = free_.back();
+        free_.pop_back();
+        return processor;
+    }
+    
+    void release(PDFProcessor* processor) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(processor);
+        }
+        available_.notify_one();
+    }
+
+private:
+    std::vector<std::unique_ptr<PDFProcessor>> processors_;
+    std::vector<PDFProcessor*> free_;
+    int waiting_ = 0;
+    std::mutex mutex_;
+    std::condition_variable available_;
+};
+
+// Reads one request line (or everything up to EOF)
+bool read_request(int fd, size_t max_bytes, std::string& request, std::string& error) {
+    char buffer[64 * 1024];
+    for (;;) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error = (errno == EAGAIN || errno == EWOULDBLOCK) ? "Timed out reading request" : std::strerror(errno);
+            return false;
+        }
+        if (n == 0) break;
+        
+        const char* newline = static_cast<const char*>(std::memchr(buffer, '\n', static_cast<size_t>(n)));
+        request.append(buffer, newline ? static_cast<size_t>(newline - buffer) : static_cast<size_t>(n));
+        if (request.size() > max_bytes) {
+            error = "Request exceeds " + std::to_string(max_bytes) + " bytes";
+            return false;
+        }
+        if (newline) break;
+    }
+    
+    if (request.empty()) {
+        error = "Empty request";
+        return false;
+    }
+    return true;
+}
+
+// Turns a connection away without waiting for its request; nothing here
+// blocks the accept loop
+void reject_busy(int fd) {
+    std::string data = json{{"ok", false}, {"error", BUSY_ERROR}}.dump() + "\n";
+    ssize_t ignored = send(fd, data.data(), data.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    (void)ignored;
+    
+    // Closing with unread input resets the connection, and the client could
+    // lose the reply, so discard whatever part of the request already arrived
+    char buffer[4096];
+    while (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    }
+}
+
+void send_response(int fd, const json& response) {
+    std::string data = response.dump() + "\n";
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;  // Client went away; nothing left to tell it
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+json handle_request(const std::string& line, ProcessorPool& pool, const ServeOptions& serve_options) {
+    json response = {{"ok", false}};
+    
+    json request;
+    try {
+        request = json::parse(line);
+    } catch (const json::exception& e) {
+        response["error"] = std::string("Invalid JSON request: ") + e.what();
+        return response;
+    }
+    if (!request.is_object()) {
+        response["error"] = "Request must be a JSON object";
+        return response;
+    }
+    if (request.contains("id")) {
+        response["id"] = request["id"];
+    }
+    
+    try {
+        // The document: a path readable by the server, or the bytes themselves
+        std::unique_ptr<TempPdf> upload;
+        std::string pdf_path;
+        if (request.contains("path") && request["path"].is_string()) {
+            pdf_path = request["path"].get<std::string>();
+        } else if (request.contains("pdf_base64") && request["pdf_base64"].is_string()) {
+            std::string bytes;
+            if (!decode_base64(request["pdf_base64"].get_ref<const std::string&>(), bytes)) {
+                response["error"] = "pdf_base64 is not valid base64";
+                return response;
+            }
+            upload = std::make_unique<TempPdf>(bytes);
+            pdf_path = upload->path();
+        } else {
+            response["error"] = "Request needs a \"path\" or \"pdf_base64\" string";
+            return response;
+        }
+        
+        json options = request.value("options", json::object());
+        if (!options.is_object()) {
+            response["error"] = "\"options\" must be an object";
+            return response;
+        }
+        
+        PDFProcessor* processor = pool.acquire(serve_options.max_queued);
+        if (!processor) {
+            response["error"] = BUSY_ERROR;
+            return response;
+        }
+        
+        // Per-request settings last for this job only. Just these fields are put
+        // back afterwards: configure() would also write the layout detector that
+        // all processors share while other jobs are using it.
+        int saved_dpi = processor->dpi();
+        int saved_ocr_dpi = processor->ocr_dpi();
+        bool saved_use_text_layer = processor->use_text_layer();
+        auto restore = [&] {
+            processor->set_dpi(saved_dpi);
+            processor->set_ocr_dpi(saved_ocr_dpi);
+            processor->set_use_text_layer(saved_use_text_layer);
+            pool.release(processor);
+        };
+        
+        ProcessingResult result;
+        try {
+            // The setters clamp to the ranges the command line accepts
+            if (options.contains("dpi")) processor->set_dpi(options["dpi"].get<int>());
+            if (options.contains("ocr_dpi")) processor->set_ocr_dpi(options["ocr_dpi"].get<int>());
+            if (options.contains("ocr_only")) processor->set_use_text_layer(!options["ocr_only"].get<bool>());
+            result = processor->process_pdf(pdf_path, "");
+        } catch (...) {
+            restore();
+            throw;
+        }
+        restore();
+        
+        if (!result.success) {
+            response["error"] = result.error_message;
+            return response;
+        }
+        
+        json outline = json::array();
+        for (const auto& heading : result.headings) {
+            outline.push_back({{"level", heading.level}, {"text", heading.text}, {"page", heading.page_number}});
+        }
+        response["ok"] = true;
+        response["title"] = result.title;
+        response["outline"] = outline;
+        response["processing_time_seconds"] = result.processing_time_seconds;
+    } catch (const std::exception& e) {
+        response["ok"] = false;
+        response["error"] = e.what();
+    }
+    
+    return response;
+}
+
+void serve_connection(int fd, ProcessorPool& pool, const ServeOptions& serve_options) {
+    std::string request;
+    std::string error;
+    json response;
+    if (read_request(fd, serve_options.max_request_bytes, request, error)) {
+        response = handle_request(request, pool, serve_options);
+    } else {
+        response = {{"ok", false}, {"error", error}};
+    }
+    send_response(fd, response);
+    
+    std::lock_guard<std::mutex> lock(print_mutex());
+    if (response["ok"].get<bool>()) {
+        std::cout << "✓ Job " << response.value("id", json()).dump() << ": "
+                  << response["outline"].size() << " heading(s) in "
+                  << response["processing_time_seconds"].get<double>() << "s\n";
+    } else {
+        std::cerr << "✗ Job " << response.value("id", json()).dump() << ": "
+                  << response["error"].get<std::string>() << "\n";
+    }
+}
+
+} // namespace
+
+int run_job_server(const ServeOptions& serve_options,
+                   const DetectorOptions& detector_options,
+                   const std::function<void(PDFProcessor&)>& configure) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (serve_options.socket_path.empty() || serve_options.socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path must be 1-" << sizeof(address.sun_path) - 1 << " characters\n";
+        return 1;
+    }
+    std::strncpy(address.sun_path, serve_options.socket_path.c_str(), sizeof(address.sun_path) - 1);
+    
+    // Load every model and OCR engine before accepting the first job
+    int concurrency = std::max(1, serve_options.max_concurrent);
+    std::cout << "Loading " << concurrency << " processor(s)...\n";
+    std::unique_ptr<ProcessorPool> pool;
+    try {
+        pool = std::make_unique<ProcessorPool>(concurrency, detector_options, configure);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Failed to initialize processors: " << e.what() << "\n";
+        return 1;
+    }
+    
+    int signal_pipe[2];
+    if (pipe(signal_pipe) != 0) {
+        std::cerr << "Error: pipe: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    g_signal_pipe = signal_pipe[1];
+    
+    struct sigaction stop_action{};
+    stop_action.sa_handler = handle_stop_signal;
+    sigemptyset(&stop_action.sa_mask);
+    struct sigaction previous_term{}, previous_int{};
+    sigaction(SIGTERM, &stop_action, &previous_term);
+    sigaction(SIGINT, &stop_action, &previous_int);
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    auto restore_signals = [&] {
+        sigaction(SIGTERM, &previous_term, nullptr);
+        sigaction(SIGINT, &previous_int, nullptr);
+        g_signal_pipe = -1;
+        close(signal_pipe[0]);
+        close(signal_pipe[1]);
+    };
+    
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        std::cerr << "Error: socket: " << std::strerror(errno) << "\n";
+        restore_signals();
+        return 1;
+    }
+    
+    // Replace a socket left behind by a previous run, but never another kind of file
+    struct stat existing{};
+    if (lstat(serve_options.socket_path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        unlink(serve_options.socket_path.c_str());
+    }
+    
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listen_fd, concurrency + serve_options.max_queued) != 0) {
+        std::cerr << "Error: Cannot listen on " << serve_options.socket_path << ": " << std::strerror(errno) << "\n";
+        close(listen_fd);
+        restore_signals();
+        return 1;
+    }
+    
+    std::cout << "🚀 Serving on " << serve_options.socket_path << " (" << concurrency
+              << " concurrent job(s), " << serve_options.max_queued << " queued)\n";
+    
+    struct Connection {
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+    std::list<std::unique_ptr<Connection>> connections;
+    
+    auto reap_finished = [&] {
+        for (auto it = connections.begin(); it != connections.end();) {
+            if ((*it)->finished) {
+                (*it)->thread.join();
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    };
+    
+    pollfd fds[2] = {{listen_fd, POLLIN, 0}, {signal_pipe[0], POLLIN, 0}};
+    for (;;) {
+        int ready = poll(fds, 2, 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: poll: " << std::strerror(errno) << "\n";
+            break;
+        }
+        reap_finished();
+        
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        
+        int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            continue;
+        }
+        
+        // Admission happens here, not once a request is read: every live
+        // connection has a thread and may buffer up to max_request_bytes
+        if (connections.size() >= static_cast<size_t>(concurrency + serve_options.max_queued)) {
+            reject_busy(client);
+            close(client);
+            std::lock_guard<std::mutex> lock(print_mutex());
+            std::cerr << "✗ Refused a connection: " << connections.size() << " already open\n";
+            continue;
+        }
+        
+        // A client that stalls mid-request must not hold its thread forever
+        timeval timeout{};
+        timeout.tv_sec = serve_options.read_timeout_seconds;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        
+        auto connection = std::make_unique<Connection>();
+        Connection* state = connection.get();
+        ProcessorPool* processors = pool.get();
+        state->thread = std::thread([state, client, processors, &serve_options] {
+            serve_connection(client, *processors, serve_options);
+            close(client);
+            state->finished = true;
+        });
+        connections.push_back(std::move(connection));
+    }
+    
+    // Graceful drain: stop taking connections, finish the ones already accepted
+    close(listen_fd);
+    unlink(serve_options.socket_path.c_str());
+    {
+        std::lock_guard<std::mutex> lock(print_mutex());
+        std::cout << "Stopping: draining " << connections.size() << " connection(s)\n";
+    }
+    for (auto& connection : connections) {
+        connection->thread.join();
+    }
+    
+    restore_signals();
+    std::cout << "Server stopped\n";
+    return 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include "common_types.h"
+
+class PDFProcessor;
+
+struct ServeOptions {
+    std::string socket_path = "/tmp/pdf_processor.sock";
+    int max_concurrent = 1;          // Jobs processed at once, one warm processor each
+    int max_queued = 16;             // Connections waiting for a processor before "busy" replies
+    size_t max_request_bytes = 32 * 1024 * 1024;  // Request line, i.e. a ~24 MB PDF in base64
+    int read_timeout_seconds = 30;   // Per connection, while reading the request
+};
+
+// Serves heading extraction over a Unix domain socket with models loaded once.
+// Each connection sends one JSON request line and gets one JSON response line:
+//
+//   {"id": "...", "path": "/abs/doc.pdf"}                    or
+//   {"id": "...", "pdf_base64": "JVBERi0...", "options": {"dpi": 150, "ocr_dpi": 300, "ocr_only": false}}
+//
+//   {"id": "...", "ok": true, "title": "...", "outline": [{"level": "H1", "text": "...", "page": 1}],
+//    "processing_time_seconds": 0.42}                         or
+//   {"id": "...", "ok": false, "error": "..."}
+//
+// Once max_concurrent + max_queued connections are open, further ones get a
+// "busy" error (without an id) as soon as they are accepted, before anything
+// is read, so memory for buffered requests stays bounded.
+// SIGTERM / SIGINT stop accepting connections and drain the jobs in progress.
+// The configure callback applies the command-line settings to each processor
+// once, at startup; per-request options are undone after each job.
+// Returns a process exit code.
+int run_job_server(const ServeOptions& serve_options,
+                   const DetectorOptions& detector_options,
+                   const std::function<void(PDFProcessor&)>& configure);
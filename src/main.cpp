@@ -5,8 +5,13 @@
 #include <vector>
 #include <algorithm>
 #include <cctype>
+#include <thread>
+#include <cstdio>
 
 #include "pdf_processor.hpp"
+#include "model_comparison.hpp"
+#include "job_server.hpp"
+#include "directory_watcher.hpp"
 #include "utils.hpp"
 
 // Helper function to find all PDF files in a directory
@@ -40,12 +45,72 @@ std::vector<std::string> find_pdf_files(const std::string& directory) {
     return pdf_files;
 }
 
+// Split a core budget between page workers and the shared ORT intra-op pool.
+// Page workers call into one session, so they run alongside its pool threads:
+// workers + (intra_op_threads - 1) pool threads use up the budget. Settings
+// given explicitly on the command line are left alone.
+void apply_core_budget(int core_budget, bool jobs_explicit, int& jobs, DetectorOptions& detector_options) {
+    int budget = core_budget > 0 ? core_budget
+                                 : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    
+    // Pages scale better than intra-op threads, so without --jobs one worker
+    // is started per 4 cores
+    if (!jobs_explicit) {
+        jobs = std::max(1, budget / 4);
+    }
+    if (detector_options.intra_op_threads <= 0) {
+        detector_options.intra_op_threads = std::max(1, budget - jobs + 1);
+    }
+}
+
 void print_usage(const char* program_name) {
     std::cout << "Usage: " << program_name << " [OPTIONS] [pdf_file]\n"
               << "\nOptions:\n"
               << "  --help, -h          Show this help message\n"
               << "  --version, -v       Show version information\n"
-              << "  --dpi <value>       Set DPI for PDF rendering (default: 100)\n"
+              << "  --dpi <value>       Set DPI for PDF rendering, 36-600 (default: 100)\n"
+              << "  --max-inflight-pages <n>\n"
+              << "                      Rendered pages kept in memory at once (default: 1)\n"
+              << "  --jobs, -j <n>      Process pages on n worker threads, 0 = all cores (default: 1)\n"
+              << "  --pipeline <r:d:o>  Pipeline pages through r render, d detect and o OCR workers\n"
+              << "                      with bounded queues of --max-inflight-pages (overrides --jobs)\n"
+              << "  --core-budget <n>   Split n cores (0 = all) between page workers and ORT threads\n"
+              << "  --intra-op-threads <n>\n"
+              << "                      ORT intra-op threads (default: min(4, cores))\n"
+              << "  --inter-op-threads <n>\n"
+              << "                      ORT inter-op threads for --ort-parallel (default: ORT's)\n"
+              << "  --ort-parallel      Run independent graph branches in parallel\n"
+              << "  --no-ort-spinning   Let idle ORT threads sleep instead of spinning\n"
+              << "  --no-ort-arena      Disable the ORT CPU memory arena\n"
+              << "  --ocr-only          Ignore the embedded PDF text layer and OCR every region\n"
+              << "  --ocr-dpi <value>   Re-render OCR regions at this DPI, 0 = crop the --dpi raster\n"
+              << "                      (0-600, default: 300)\n"
+              << "  --detector-size <n> Layout model input size, e.g. 640 for faster inference\n"
+              << "                      (default: the model's own input size)\n"
+              << "  --int8              Use the INT8 quantized layout model when available\n"
+              << "  --compare-int8 <dir>\n"
+              << "                      Run FP32 and INT8 models over the PDFs in dir and report\n"
+              << "                      per-page latency and heading-level agreement (to --output)\n"
+              << "  --serve <socket>    Keep models loaded and take jobs over a Unix socket\n"
+              << "  --serve-concurrency <n>\n"
+              << "                      Jobs processed at once in --serve mode (default: 1)\n"
+              << "  --serve-queue <n>   Jobs waiting for a slot before the server replies busy\n"
+              << "                      (default: 16)\n"
+              << "  --watch             Keep running and process PDFs as they arrive in /app/input/\n"
+              << "  --watch-dir <dir>   Watch dir instead of /app/input/ (implies --watch)\n"
+              << "  --result-cache <dir>\n"
+              << "                      Reuse results for PDFs already processed with the same settings\n"
+              << "  --result-cache-mb <n>\n"
+              << "                      Size limit of the result cache (default: 1024)\n"
+              << "  --model-cache-dir <dir>\n"
+              << "                      Cache ORT-optimized models here (default: models/*/ort_cache)\n"
+              << "  --no-model-cache    Optimize the model graph on every start\n"
+              << "  --max-detections <n>\n"
+              << "                      Keep at most n layout regions per page, 0 = no cap\n"
+              << "                      (default: the model config.json max_detections, else 0)\n"
+              << "  --render-for-detector\n"
+              << "                      Render pages directly at the layout model input size\n"
+              << "                      (letterboxed); --dpi then only applies to OCR\n"
               << "  --output, -o <file> Output JSON file path (default: /app/output/heading_schema.json)\n"
               << "  --verbose           Enable verbose logging\n"
               << "\nBehavior:\n"
@@ -56,6 +121,7 @@ void print_usage(const char* program_name) {
               << "  " << program_name << "                    # Process all PDFs in /app/input/\n"
               << "  " << program_name << " document.pdf       # Process specific file\n"
               << "  " << program_name << " --dpi 150 document.pdf\n"
+              << "  " << program_name << " --jobs 8 document.pdf\n"
               << "  " << program_name << " -o results.json document.pdf\n";
 }
 
@@ -78,14 +144,32 @@ void print_version() {
 #endif
 
     std::cout << "  ✓ OpenCV " << CV_VERSION << "\n"
-              << "  ✓ Sequential processing only\n";
+              << "  ✓ Parallel page processing (--jobs, up to " << std::thread::hardware_concurrency() << " cores)\n";
 }
 
 int main(int argc, char* argv[]) {
     // Parse command line arguments
     std::string pdf_file;
     std::string output_file = "/app/output/heading_schema.json";
+    bool output_explicit = false;
+    std::string compare_int8_dir;
+    ServeOptions serve_options;
+    bool serve = false;
+    WatchOptions watch_options;
+    bool watch = false;
+    std::string result_cache_dir;
+    int result_cache_mb = 1024;
     int dpi = 100;
+    int max_inflight_pages = 1;
+    int jobs = 1;
+    bool jobs_explicit = false;
+    int pipeline_render = 0, pipeline_detect = 0, pipeline_ocr = 0;
+    int core_budget = -1;
+    bool use_text_layer = true;
+    int ocr_dpi = 300;
+    int max_detections = -1;  // -1 = the model config's max_detections, else no cap
+    DetectorOptions detector_options;
+    bool render_for_detector = false;
     bool verbose = false;
     
     for (int i = 1; i < argc; ++i) {
@@ -103,10 +187,97 @@ int main(int argc, char* argv[]) {
             verbose = true;
         }
         else if (arg == "--dpi" && i + 1 < argc) {
-            dpi = std::stoi(argv[++i]);
+            dpi = std::clamp(std::stoi(argv[++i]), PDFProcessor::MIN_DPI, PDFProcessor::MAX_DPI);
+        }
+        else if (arg == "--max-inflight-pages" && i + 1 < argc) {
+            max_inflight_pages = std::stoi(argv[++i]);
+        }
+        else if ((arg == "--jobs" || arg == "-j") && i + 1 < argc) {
+            jobs = std::stoi(argv[++i]);
+            if (jobs <= 0) {
+                jobs = std::max(1u, std::thread::hardware_concurrency());
+            }
+            jobs_explicit = true;
+        }
+        else if (arg == "--pipeline" && i + 1 < argc) {
+            std::string stages = argv[++i];
+            if (std::sscanf(stages.c_str(), "%d:%d:%d", &pipeline_render, &pipeline_detect, &pipeline_ocr) != 3 ||
+                pipeline_render <= 0 || pipeline_detect <= 0 || pipeline_ocr <= 0) {
+                std::cerr << "Error: --pipeline expects render:detect:ocr worker counts, e.g. 2:1:4\n";
+                return 1;
+            }
+        }
+        else if (arg == "--core-budget" && i + 1 < argc) {
+            core_budget = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--intra-op-threads" && i + 1 < argc) {
+            detector_options.intra_op_threads = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--inter-op-threads" && i + 1 < argc) {
+            detector_options.inter_op_threads = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--ort-parallel") {
+            detector_options.parallel_execution = true;
+        }
+        else if (arg == "--no-ort-spinning") {
+            detector_options.allow_spinning = false;
+        }
+        else if (arg == "--no-ort-arena") {
+            detector_options.cpu_mem_arena = false;
+        }
+        else if (arg == "--ocr-only") {
+            use_text_layer = false;
+        }
+        else if (arg == "--ocr-dpi" && i + 1 < argc) {
+            ocr_dpi = std::clamp(std::stoi(argv[++i]), 0, PDFProcessor::MAX_DPI);
+        }
+        else if (arg == "--detector-size" && i + 1 < argc) {
+            detector_options.input_size = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--int8") {
+            detector_options.int8 = true;
+        }
+        else if (arg == "--compare-int8" && i + 1 < argc) {
+            compare_int8_dir = argv[++i];
+        }
+        else if (arg == "--serve" && i + 1 < argc) {
+            serve_options.socket_path = argv[++i];
+            serve = true;
+        }
+        else if (arg == "--serve-concurrency" && i + 1 < argc) {
+            serve_options.max_concurrent = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--serve-queue" && i + 1 < argc) {
+            serve_options.max_queued = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--watch") {
+            watch = true;
+        }
+        else if (arg == "--watch-dir" && i + 1 < argc) {
+            watch_options.input_dir = argv[++i];
+            watch = true;
+        }
+        else if (arg == "--result-cache" && i + 1 < argc) {
+            result_cache_dir = argv[++i];
+        }
+        else if (arg == "--result-cache-mb" && i + 1 < argc) {
+            result_cache_mb = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--model-cache-dir" && i + 1 < argc) {
+            detector_options.model_cache_dir = argv[++i];
+        }
+        else if (arg == "--no-model-cache") {
+            detector_options.optimized_model_cache = false;
+        }
+        else if (arg == "--max-detections" && i + 1 < argc) {
+            max_detections = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--render-for-detector") {
+            render_for_detector = true;
         }
         else if ((arg == "--output" || arg == "-o") && i + 1 < argc) {
             output_file = argv[++i];
+            output_explicit = true;
         }
         else if (arg[0] != '-') {
             if (pdf_file.empty()) {
@@ -123,6 +294,48 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    if (core_budget >= 0) {
+        apply_core_budget(core_budget, jobs_explicit, jobs, detector_options);
+    }
+    
+    auto configure_processor = [&](PDFProcessor& processor) {
+        processor.set_dpi(dpi);
+        processor.set_max_inflight_pages(max_inflight_pages);
+        processor.set_jobs(jobs);
+        processor.set_pipeline_workers(pipeline_render, pipeline_detect, pipeline_ocr);
+        processor.set_use_text_layer(use_text_layer);
+        processor.set_ocr_dpi(ocr_dpi);
+        if (max_detections >= 0) {
+            processor.set_max_detections(max_detections);
+        }
+        processor.set_render_for_detector(render_for_detector);
+        processor.set_result_cache(result_cache_dir, static_cast<uint64_t>(result_cache_mb) * 1024 * 1024);
+    };
+    
+    if (serve) {
+        return run_job_server(serve_options, detector_options, configure_processor);
+    }
+    
+    if (watch) {
+        // Outputs go next to --output, as in batch mode
+        std::string output_dir = std::filesystem::path(output_file).parent_path().string();
+        watch_options.output_dir = output_dir.empty() ? "/app/output" : output_dir;
+        
+        PDFProcessor processor(detector_options);
+        configure_processor(processor);
+        return run_watch_mode(watch_options, processor);
+    }
+    
+    if (!compare_int8_dir.empty()) {
+        std::vector<std::string> corpus = find_pdf_files(compare_int8_dir);
+        if (corpus.empty()) {
+            std::cerr << "Error: No PDF files found in " << compare_int8_dir << "\n";
+            return 1;
+        }
+        std::string report_path = output_explicit ? output_file : "/app/output/int8_comparison.json";
+        return run_int8_comparison(corpus, report_path, detector_options, configure_processor);
+    }
+    
     // Determine files to process
     std::vector<std::string> files_to_process;
     
@@ -145,78 +358,120 @@ int main(int argc, char* argv[]) {
     }
     
     // Create processor and configure
-    PDFProcessor processor;
-    processor.set_dpi(dpi);
+    PDFProcessor processor(detector_options);
+    configure_processor(processor);
     
     // Process each file
     int successful_files = 0;
     int total_headings = 0;
     double total_time = 0.0;
+    auto batch_start = std::chrono::steady_clock::now();
     
-    for (size_t i = 0; i < files_to_process.size(); ++i) {
-        const std::string& current_file = files_to_process[i];
-        
-        // Generate output filename for each file
-        std::string current_output;
+    // Generate output filename for each file
+    auto output_for = [&](const std::string& current_file) {
         if (files_to_process.size() == 1) {
-            current_output = output_file;
-        } else {
-            // Multiple files: generate unique output names
-            std::filesystem::path input_path(current_file);
-            std::string base_name = input_path.stem().string();
-            std::filesystem::path output_path(output_file);
-            std::string output_dir = output_path.parent_path().string();
-            std::string output_ext = output_path.extension().string();
-            
-            if (output_dir.empty()) output_dir = "/app/output";
-            current_output = output_dir + "/" + base_name + "_headings" + output_ext;
+            return output_file;
         }
         
-        if (verbose || files_to_process.size() > 1) {
-            std::cout << "\n[" << (i + 1) << "/" << files_to_process.size() << "] Processing: " << current_file << "\n";
-            std::cout << "Configuration:\n"
-                      << "  PDF File: " << current_file << "\n"
-                      << "  Output: " << current_output << "\n"
-                      << "  DPI: " << dpi << "\n"
-                      << "  Processing: Sequential only\n"
-                      << "\n";
-        }
+        // Multiple files: generate unique output names
+        std::filesystem::path input_path(current_file);
+        std::string base_name = input_path.stem().string();
+        std::filesystem::path output_path(output_file);
+        std::string output_dir = output_path.parent_path().string();
+        std::string output_ext = output_path.extension().string();
         
-        // Process PDF
-        utils::Timer file_timer("File processing");
-        
-        try {
-            auto result = processor.process_pdf(current_file, current_output);
+        if (output_dir.empty()) output_dir = "/app/output";
+        return output_dir + "/" + base_name + "_headings" + output_ext;
+    };
+    
+    auto print_configuration = [&](const std::string& current_file, const std::string& current_output) {
+        std::cout << "Configuration:\n";
+        if (!current_file.empty()) {
+            std::cout << "  PDF File: " << current_file << "\n"
+                      << "  Output: " << current_output << "\n";
+        }
+        std::cout << "  DPI: " << dpi << "\n"
+                  << "  Max in-flight pages: " << max_inflight_pages << "\n"
+                  << "  Page workers: " << (pipeline_render > 0 ? std::to_string(pipeline_render) + ":" + std::to_string(pipeline_detect) + ":" + std::to_string(pipeline_ocr) + " (render:detect:ocr)" : std::to_string(jobs)) << "\n"
+                  << "  ORT intra-op threads: " << (detector_options.intra_op_threads > 0 ? std::to_string(detector_options.intra_op_threads) : "auto") << "\n"
+                  << "  Text source: " << (use_text_layer ? "PDF text layer, OCR fallback" : "OCR only") << "\n"
+                  << "  Detector size: " << (detector_options.input_size > 0 ? std::to_string(detector_options.input_size) : "model default") << "\n"
+                  << "  OCR DPI: " << (ocr_dpi > 0 ? std::to_string(ocr_dpi) : "page raster") << "\n"
+                  << "\n";
+    };
+    
+    auto report_result = [&](const std::string& current_file, const std::string& current_output,
+                             const ProcessingResult& result) {
+        if (result.success) {
+            successful_files++;
+            total_headings += result.headings.size();
+            total_time += result.processing_time_seconds;
             
-            if (result.success) {
-                successful_files++;
-                total_headings += result.headings.size();
-                total_time += result.processing_time_seconds;
-                
-                std::cout << "✓ " << current_file << " processed successfully!\n"
-                          << "  Title: " << result.title << "\n"
-                          << "  Headings found: " << result.headings.size() << "\n"
-                          << "  Processing time: " << result.processing_time_seconds << "s\n"
-                          << "  Output saved to: " << current_output << "\n";
-                
-                if (verbose) {
-                    std::cout << "\nHeading breakdown:\n";
-                    int h1_count = 0, h2_count = 0, h3_count = 0;
-                    for (const auto& heading : result.headings) {
-                        if (heading.level == "H1") h1_count++;
-                        else if (heading.level == "H2") h2_count++;
-                        else if (heading.level == "H3") h3_count++;
-                    }
-                    std::cout << "  H1: " << h1_count << ", H2: " << h2_count << ", H3: " << h3_count << "\n";
+            std::cout << "✓ " << current_file << " processed successfully!\n"
+                      << "  Title: " << result.title << "\n"
+                      << "  Headings found: " << result.headings.size() << "\n"
+                      << "  Processing time: " << result.processing_time_seconds << "s\n"
+                      << "  Output saved to: " << current_output << "\n";
+            
+            if (verbose) {
+                std::cout << "\nHeading breakdown:\n";
+                int h1_count = 0, h2_count = 0, h3_count = 0;
+                for (const auto& heading : result.headings) {
+                    if (heading.level == "H1") h1_count++;
+                    else if (heading.level == "H2") h2_count++;
+                    else if (heading.level == "H3") h3_count++;
                 }
-            } else {
-                std::cerr << "✗ Failed to process " << current_file << ": " << result.error_message << "\n";
+                std::cout << "  H1: " << h1_count << ", H2: " << h2_count << ", H3: " << h3_count << "\n";
             }
+        } else {
+            std::cerr << "✗ Failed to process " << current_file << ": " << result.error_message << "\n";
+        }
+    };
+    
+    if (files_to_process.size() > 1 && jobs > 1) {
+        // Schedule (file, page) tasks across all workers instead of one file at a
+        // time; with --pipeline, process_batch runs the files through it in turn
+        std::vector<BatchItem> items;
+        for (const auto& current_file : files_to_process) {
+            items.push_back({current_file, output_for(current_file)});
+        }
+        
+        std::cout << "\nProcessing " << items.size() << " files as one batch\n";
+        print_configuration("", "");
+        
+        size_t finished = 0;
+        try {
+            processor.process_batch(items, [&](size_t index, const ProcessingResult& result) {
+                std::cout << "\n[" << ++finished << "/" << items.size() << "] Finished: " << items[index].pdf_path << "\n";
+                report_result(items[index].pdf_path, items[index].output_json, result);
+            });
         }
         catch (const std::exception& e) {
-            std::cerr << "✗ Unexpected error processing " << current_file << ": " << e.what() << "\n";
+            std::cerr << "✗ Batch processing failed: " << e.what() << "\n";
+        }
+    } else {
+        for (size_t i = 0; i < files_to_process.size(); ++i) {
+            const std::string& current_file = files_to_process[i];
+            std::string current_output = output_for(current_file);
+            
+            if (verbose || files_to_process.size() > 1) {
+                std::cout << "\n[" << (i + 1) << "/" << files_to_process.size() << "] Processing: " << current_file << "\n";
+                print_configuration(current_file, current_output);
+            }
+            
+            // Process PDF
+            utils::Timer file_timer("File processing");
+            
+            try {
+                auto result = processor.process_pdf(current_file, current_output);
+                report_result(current_file, current_output, result);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "✗ Unexpected error processing " << current_file << ": " << e.what() << "\n";
+            }
         }
     }
+    double batch_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batch_start).count();
     
     // Summary for multiple files
     if (files_to_process.size() > 1) {
@@ -226,6 +481,7 @@ int main(int argc, char* argv[]) {
         std::cout << "Files processed: " << successful_files << "/" << files_to_process.size() << "\n";
         std::cout << "Total headings found: " << total_headings << "\n";
         std::cout << "Total processing time: " << total_time << "s\n";
+        std::cout << "Wall time: " << batch_seconds << "s\n";
         std::cout << "Average time per file: " << (successful_files > 0 ? total_time / successful_files : 0.0) << "s\n";
     }
     
@@ -0,0 +1,216 @@
+#include "model_comparison.hpp"
+#include "pdf_processor.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+struct LatencyStats {
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+};
+
+LatencyStats latency_stats(std::vector<double> samples) {
+    LatencyStats stats;
+    if (samples.empty()) return stats;
+    
+    std::sort(samples.begin(), samples.end());
+    stats.mean_ms = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    stats.p50_ms = samples[(samples.size() - 1) / 2];
+    stats.p95_ms = samples[std::min(samples.size() - 1, static_cast<size_t>(samples.size() * 0.95))];
+    return stats;
+}
+
+json stats_to_json(const LatencyStats& stats) {
+    return {{"mean_ms", stats.mean_ms}, {"p50_ms", stats.p50_ms}, {"p95_ms", stats.p95_ms}};
+}
+
+// Headings are matched by page and normalized text
+std::string normalize_heading(const std::string& text) {
+    std::string normalized;
+    bool in_space = false;
+    for (char c : utils::to_lower(utils::trim(text))) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            in_space = true;
+            continue;
+        }
+        if (in_space && !normalized.empty()) normalized += ' ';
+        in_space = false;
+        normalized += c;
+    }
+    return normalized;
+}
+
+struct Agreement {
+    int headings_either = 0;  // Distinct headings found by either model
+    int matched = 0;          // Found by both
+    int same_level = 0;       // Found by both with the same level
+};
+
+Agreement compare_headings(const std::vector<HeadingInfo>& reference, const std::vector<HeadingInfo>& candidate) {
+    using Key = std::pair<int, std::string>;
+    std::map<Key, std::vector<std::string>> reference_levels, candidate_levels;
+    for (const auto& heading : reference) {
+        reference_levels[{heading.page_number, normalize_heading(heading.text)}].push_back(heading.level);
+    }
+    for (const auto& heading : candidate) {
+        candidate_levels[{heading.page_number, normalize_heading(heading.text)}].push_back(heading.level);
+    }
+    
+    Agreement agreement;
+    auto count_key = [&](const Key& key) {
+        const auto& a = reference_levels[key];
+        const auto& b = candidate_levels[key];
+        size_t matched = std::min(a.size(), b.size());
+        agreement.headings_either += static_cast<int>(std::max(a.size(), b.size()));
+        agreement.matched += static_cast<int>(matched);
+        for (size_t i = 0; i < matched; ++i) {
+            if (a[i] == b[i]) agreement.same_level++;
+        }
+    };
+    
+    for (const auto& entry : reference_levels) {
+        count_key(entry.first);
+    }
+    for (const auto& entry : candidate_levels) {
+        if (!reference_levels.count(entry.first)) count_key(entry.first);
+    }
+    return agreement;
+}
+
+double ratio(int numerator, int denominator) {
+    return denominator > 0 ? static_cast<double>(numerator) / denominator : 1.0;
+}
+
+} // namespace
+
+int run_int8_comparison(const std::vector<std::string>& pdf_files,
+                        const std::string& report_path,
+                        const DetectorOptions& base_options,
+                        const std::function<void(PDFProcessor&)>& configure) {
+    DetectorOptions fp32_options = base_options;
+    fp32_options.int8 = false;
+    DetectorOptions int8_options = base_options;
+    int8_options.int8 = true;
+    
+    PDFProcessor fp32_processor(fp32_options);
+    PDFProcessor int8_processor(int8_options);
+    configure(fp32_processor);
+    configure(int8_processor);
+    // Cached results would report the timings of whichever run stored them
+    fp32_processor.set_result_cache("", 0);
+    int8_processor.set_result_cache("", 0);
+    
+    std::string fp32_model = fp32_processor.detector_model_path();
+    std::string int8_model = int8_processor.detector_model_path();
+    if (fp32_model.empty() || int8_model.empty() || fp32_model == int8_model) {
+        std::cerr << "Error: INT8 comparison needs both an FP32 and an INT8 layout model "
+                  << "(e.g. models/yolo_layout/yolo_layout_int8.onnx)\n";
+        return 1;
+    }
+    
+    std::cout << "Comparing layout models over " << pdf_files.size() << " PDF(s)\n"
+              << "  FP32: " << fp32_model << "\n"
+              << "  INT8: " << int8_model << "\n";
+    
+    // Per-model outputs go next to the report for inspection
+    std::filesystem::path report(report_path);
+    std::filesystem::path output_dir = report.parent_path() / (report.stem().string() + "_outputs");
+    utils::ensure_directory_exists(output_dir.string());
+    
+    json files = json::array();
+    std::vector<double> all_fp32_ms, all_int8_ms;
+    Agreement total;
+    int failures = 0;
+    
+    for (const auto& pdf : pdf_files) {
+        std::string stem = utils::get_filename_without_extension(pdf);
+        std::cout << "\n📄 " << pdf << "\n";
+        
+        ProcessingResult fp32 = fp32_processor.process_pdf(pdf, (output_dir / (stem + "_fp32.json")).string());
+        ProcessingResult int8 = int8_processor.process_pdf(pdf, (output_dir / (stem + "_int8.json")).string());
+        if (!fp32.success || !int8.success) {
+            std::cerr << "Error: skipping " << pdf << ": "
+                      << (fp32.success ? int8.error_message : fp32.error_message) << "\n";
+            failures++;
+            continue;
+        }
+        
+        Agreement agreement = compare_headings(fp32.headings, int8.headings);
+        total.headings_either += agreement.headings_either;
+        total.matched += agreement.matched;
+        total.same_level += agreement.same_level;
+        all_fp32_ms.insert(all_fp32_ms.end(), fp32.page_detection_ms.begin(), fp32.page_detection_ms.end());
+        all_int8_ms.insert(all_int8_ms.end(), int8.page_detection_ms.begin(), int8.page_detection_ms.end());
+        
+        files.push_back({
+            {"file", pdf},
+            {"pages", fp32.page_detection_ms.size()},
+            {"fp32", stats_to_json(latency_stats(fp32.page_detection_ms))},
+            {"int8", stats_to_json(latency_stats(int8.page_detection_ms))},
+            {"fp32_page_ms", fp32.page_detection_ms},
+            {"int8_page_ms", int8.page_detection_ms},
+            {"headings_fp32", fp32.headings.size()},
+            {"headings_int8", int8.headings.size()},
+            {"heading_match_rate", ratio(agreement.matched, agreement.headings_either)},
+            {"level_agreement", ratio(agreement.same_level, agreement.headings_either)}
+        });
+    }
+    
+    LatencyStats fp32_stats = latency_stats(all_fp32_ms);
+    LatencyStats int8_stats = latency_stats(all_int8_ms);
+    double speedup = int8_stats.p50_ms > 0.0 ? fp32_stats.p50_ms / int8_stats.p50_ms : 0.0;
+    
+    json summary = {
+        {"files", pdf_files.size() - failures},
+        {"failed_files", failures},
+        {"pages", all_fp32_ms.size()},
+        {"fp32", stats_to_json(fp32_stats)},
+        {"int8", stats_to_json(int8_stats)},
+        {"p50_speedup", speedup},
+        {"headings_either", total.headings_either},
+        {"heading_match_rate", ratio(total.matched, total.headings_either)},
+        {"level_agreement", ratio(total.same_level, total.headings_either)}
+    };
+    
+    json report_json = {
+        {"fp32_model", fp32_model},
+        {"int8_model", int8_model},
+        {"summary", summary},
+        {"files", files}
+    };
+    
+    std::ofstream out(report_path);
+    if (!out.is_open()) {
+        std::cerr << "Error: Cannot write comparison report: " << report_path << "\n";
+        return 1;
+    }
+    out << report_json.dump(2) << "\n";
+    
+    std::cout << std::fixed << std::setprecision(1)
+              << "\n=== INT8 vs FP32 layout model ===\n"
+              << "Pages: " << all_fp32_ms.size() << "\n"
+              << "Detection per page (mean / p50 / p95 ms):\n"
+              << "  FP32: " << fp32_stats.mean_ms << " / " << fp32_stats.p50_ms << " / " << fp32_stats.p95_ms << "\n"
+              << "  INT8: " << int8_stats.mean_ms << " / " << int8_stats.p50_ms << " / " << int8_stats.p95_ms << "\n"
+              << std::setprecision(2)
+              << "p50 speedup: " << speedup << "x\n"
+              << std::setprecision(1)
+              << "Headings found by both: " << 100.0 * ratio(total.matched, total.headings_either) << "%\n"
+              << "Heading-level agreement: " << 100.0 * ratio(total.same_level, total.headings_either) << "%\n"
+              << "Report: " << report_path << "\n";
+    
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include "common_types.h"
+
+class PDFProcessor;
+
+// Runs the FP32 and INT8 layout models over the same PDFs and reports per-page
+// detection latency and how often both models assign the same heading level.
+// Every other setting comes from base_options and the configure callback, so
+// the two runs differ only in the model. Per-model outputs are written next to
+// the report. Returns a process exit code.
+int run_int8_comparison(const std::vector<std::string>& pdf_files,
+                        const std::string& report_path,
+                        const DetectorOptions& base_options,
+                        const std::function<void(PDFProcessor&)>& configure);
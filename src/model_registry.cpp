@@ -0,0 +1,50 @@
+#include "model_registry.hpp"
+#include "yolo_inference.h"
+
+#include <iostream>
+
+ModelRegistry& ModelRegistry::instance() {
+    static ModelRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<YOLOInference> ModelRegistry::layout_detector(const std::string& model_dir,
+                                                              const DetectorOptions& options) {
+    std::string key = make_key(model_dir, options);
+    
+    // Loading happens under the lock so concurrent callers wait for the first
+    // load instead of starting their own
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    auto it = layout_detectors_.find(key);
+    if (it != layout_detectors_.end()) {
+        if (auto detector = it->second.lock()) {
+            std::cout << "♻️ Reusing loaded layout model: " << model_dir << std::endl;
+            return detector;
+        }
+    }
+    
+    auto detector = std::make_shared<YOLOInference>(options);
+    if (!detector->initialize(model_dir)) {
+        return nullptr;
+    }
+    
+    layout_detectors_[key] = detector;
+    return detector;
+}
+
+std::string ModelRegistry::make_key(const std::string& model_dir, const DetectorOptions& options) {
+    // Normalize the trailing slash so "models/x" and "models/x/" share a model
+    std::string dir = model_dir;
+    while (dir.size() > 1 && dir.back() == '/') {
+        dir.pop_back();
+    }
+    // Everything that changes how the session is built or run is part of the key
+    return dir + "|size=" + std::to_string(options.input_size) +
+           "|int8=" + std::to_string(options.int8) +
+           "|intra=" + std::to_string(options.intra_op_threads) +
+           "|inter=" + std::to_string(options.inter_op_threads) +
+           "|parallel=" + std::to_string(options.parallel_execution) +
+           "|spin=" + std::to_string(options.allow_spinning) +
+           "|arena=" + std::to_string(options.cpu_mem_arena);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "common_types.h"
+
+class YOLOInference;
+
+// Process-wide registry of loaded models. Each layout model is loaded once per
+// (model directory, detector options) and handed out as a shared handle, so
+// PDFProcessor and HeadingClassifier run on the same ONNX session instead of
+// loading their own copies. A model is released when its last handle goes away.
+class ModelRegistry {
+public:
+    static ModelRegistry& instance();
+    
+    // Shared layout detector for model_dir, loading it on first use
+    std::shared_ptr<YOLOInference> layout_detector(const std::string& model_dir,
+                                                   const DetectorOptions& options = DetectorOptions());
+    
+private:
+    ModelRegistry() = default;
+    ModelRegistry(const ModelRegistry&) = delete;
+    ModelRegistry& operator=(const ModelRegistry&) = delete;
+    
+    static std::string make_key(const std::string& model_dir, const DetectorOptions& options);
+    
+    std::mutex mutex_;
+    std::map<std::string, std::weak_ptr<YOLOInference>> layout_detectors_;
+};
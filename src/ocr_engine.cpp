@@ -0,0 +1,110 @@
+#include "ocr_engine.hpp"
+
+#include <tesseract/baseapi.h>
+#include <tesseract/resultiterator.h>
+#include <iostream>
+
+OCREngine::OCREngine() = default;
+
+OCREngine::~OCREngine() {
+    if (api_) {
+        api_->End();
+    }
+}
+
+bool OCREngine::initialize(const std::string& language, const std::string& datapath) {
+    api_ = std::make_unique<tesseract::TessBaseAPI>();
+    
+    if (api_->Init(datapath.empty() ? nullptr : datapath.c_str(), language.c_str(),
+                   tesseract::OEM_DEFAULT) != 0) {
+        std::cerr << "[ERROR] Tesseract initialization failed for language: " << language << std::endl;
+        api_.reset();
+        initialized_ = false;
+        return false;
+    }
+    
+    // Same segmentation as the former `tesseract ... --psm 6` invocation
+    api_->SetPageSegMode(tesseract::PSM_SINGLE_BLOCK);
+    api_->SetVariable("debug_file", "/dev/null");
+    
+    initialized_ = true;
+    return true;
+}
+
+void OCREngine::set_page(const cv::Mat& page, int dpi) {
+    has_page_ = false;
+    if (!initialized_ || page.empty()) {
+        return;
+    }
+    
+    if (page.channels() == 3) {
+        cv::cvtColor(page, page_gray_, cv::COLOR_BGR2GRAY);
+    } else {
+        page_gray_ = page;
+    }
+    
+    api_->SetImage(page_gray_.data, page_gray_.cols, page_gray_.rows, 1,
+                   static_cast<int>(page_gray_.step[0]));
+    api_->SetSourceResolution(dpi);
+    has_page_ = true;
+}
+
+void OCREngine::clear_page() {
+    if (api_) {
+        api_->Clear();
+    }
+    page_gray_.release();
+    has_page_ = false;
+}
+
+OCRResult OCREngine::recognize(const cv::Rect& region) {
+    OCRResult result;
+    if (!initialized_ || !has_page_) {
+        return result;
+    }
+    
+    cv::Rect safe_region = region & cv::Rect(0, 0, page_gray_.cols, page_gray_.rows);
+    if (safe_region.width <= 0 || safe_region.height <= 0) {
+        return result;
+    }
+    
+    api_->SetRectangle(safe_region.x, safe_region.y, safe_region.width, safe_region.height);
+    if (api_->Recognize(nullptr) != 0) {
+        return result;
+    }
+    
+    char* text = api_->GetUTF8Text();
+    if (text) {
+        result.text = text;
+        delete[] text;
+    }
+    
+    // Collect per-word confidences
+    std::unique_ptr<tesseract::ResultIterator> it(api_->GetIterator());
+    if (it) {
+        float confidence_sum = 0.0f;
+        do {
+            char* word = it->GetUTF8Text(tesseract::RIL_WORD);
+            if (!word) continue;
+            
+            OCRWord ocr_word;
+            ocr_word.text = word;
+            ocr_word.confidence = it->Confidence(tesseract::RIL_WORD);
+            
+            int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+            if (it->BoundingBox(tesseract::RIL_WORD, &x1, &y1, &x2, &y2)) {
+                ocr_word.bbox = cv::Rect(x1, y1, x2 - x1, y2 - y1);
+            }
+            delete[] word;
+            
+            confidence_sum += ocr_word.confidence;
+            result.words.push_back(std::move(ocr_word));
+        } while (it->Next(tesseract::RIL_WORD));
+        
+        if (!result.words.empty()) {
+            result.mean_confidence = confidence_sum / result.words.size();
+        }
+    }
+    
+    return result;
+}
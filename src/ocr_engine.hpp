@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace tesseract {
+class TessBaseAPI;
+}
+
+struct OCRWord {
+    std::string text;
+    float confidence;  // 0-100 as reported by Tesseract
+    cv::Rect bbox;     // In page image coordinates
+};
+
+struct OCRResult {
+    std::string text;
+    std::vector<OCRWord> words;
+    float mean_confidence = 0.0f;
+};
+
+// In-process Tesseract OCR. The engine is initialized once and reused; a page is
+// handed over once with set_page() and regions are then recognized in place via
+// SetRectangle, without copying or encoding the crop.
+//
+// An OCREngine is not thread-safe - every page worker needs its own instance.
+class OCREngine {
+public:
+    OCREngine();
+    ~OCREngine();
+    
+    OCREngine(const OCREngine&) = delete;
+    OCREngine& operator=(const OCREngine&) = delete;
+    
+    // Load language data; datapath empty means Tesseract's default location
+    bool initialize(const std::string& language = "eng", const std::string& datapath = "");
+    bool is_initialized() const { return initialized_; }
+    
+    // Set the page that subsequent recognize() calls read from. The page must
+    // outlive those calls; BGR pages are converted to grayscale once here.
+    void set_page(const cv::Mat& page, int dpi);
+    
+    // Drop the current page so an idle engine does not pin page memory
+    void clear_page();
+    
+    // Recognize a region of the current page
+    OCRResult recognize(const cv::Rect& region);
+    
+private:
+    std::unique_ptr<tesseract::TessBaseAPI> api_;
+    cv::Mat page_gray_;
+    bool initialized_ = false;
+    bool has_page_ = false;
+};
@@ -0,0 +1,263 @@
+#include "pdf_document.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+#ifdef USE_MUPDF
+
+PDFDocument::PDFDocument(fz_context* ctx, const std::string& pdf_path)
+    : ctx_(ctx), path_(pdf_path) {
+    fz_document* doc = NULL;
+    int page_count = 0;
+    fz_var(doc);
+    
+    fz_try(ctx_) {
+        doc = fz_open_document(ctx_, pdf_path.c_str());
+        page_count = fz_count_pages(ctx_, doc);
+    }
+    fz_catch(ctx_) {
+        if (doc) fz_drop_document(ctx_, doc);
+        throw std::runtime_error("MuPDF error opening PDF: " + pdf_path);
+    }
+    
+    doc_ = doc;
+    page_count_ = page_count;
+}
+
+PDFDocument::~PDFDocument() {
+    if (doc_) {
+        fz_drop_document(ctx_, doc_);
+    }
+}
+
+std::string PDFDocument::metadata_title() const {
+    char info[512] = { 0 };
+    int found = -1;
+    
+    fz_try(ctx_) {
+        found = fz_lookup_metadata(ctx_, doc_, FZ_META_INFO_TITLE, info, sizeof(info));
+    }
+    fz_catch(ctx_) {
+        return "";
+    }
+    
+    if (found >= 0 && strlen(info) > 0) {
+        return std::string(info);
+    }
+    return "";
+}
+
+std::unique_ptr<PDFPage> PDFDocument::load_page(int page_index) {
+    fz_page* page = NULL;
+    fz_display_list* list = NULL;
+    fz_rect bounds;
+    fz_var(page);
+    
+    fz_try(ctx_) {
+        page = fz_load_page(ctx_, doc_, page_index);
+        bounds = fz_bound_page(ctx_, page);
+        
+        // Interpret the content stream once; the fz_page is no longer needed afterwards
+        list = fz_new_display_list_from_page(ctx_, page);
+    }
+    fz_always(ctx_) {
+        if (page) fz_drop_page(ctx_, page);
+    }
+    fz_catch(ctx_) {
+        throw std::runtime_error("MuPDF error loading page " + std::to_string(page_index + 1));
+    }
+    
+    return std::make_unique<PDFPage>(ctx_, list, bounds, page_index);
+}
+
+PDFPage::PDFPage(fz_context* ctx, fz_display_list* list, fz_rect bounds, int page_index)
+    : ctx_(ctx), list_(list), bounds_(bounds), page_index_(page_index) {
+}
+
+PDFPage::~PDFPage() {
+    if (stext_) fz_drop_stext_page(ctx_, stext_);
+    if (list_) fz_drop_display_list(ctx_, list_);
+}
+
+cv::Mat PDFPage::render(int dpi) {
+    cv::Mat img;
+    fz_pixmap* pix = NULL;
+    fz_device* dev = NULL;
+    fz_var(pix);
+    fz_var(dev);
+    
+    // Create transformation matrix for DPI
+    fz_matrix transform = fz_scale(dpi / 72.0f, dpi / 72.0f);
+    fz_irect bbox = fz_round_rect(fz_transform_rect(bounds_, transform));
+    int width = bbox.x1 - bbox.x0;
+    int height = bbox.y1 - bbox.y0;
+    if (width <= 0 || height <= 0) {
+        return img;
+    }
+    
+    // The cv::Mat owns the pixels and MuPDF draws straight into it, in BGR
+    // order, so there is no copy and no channel swizzle afterwards
+    img.create(height, width, CV_8UC3);
+    
+    fz_try(ctx_) {
+        pix = fz_new_pixmap_with_bbox_and_data(ctx_, fz_device_bgr(ctx_), bbox, NULL, 0, img.data);
+        fz_clear_pixmap_with_value(ctx_, pix, 0xFF);
+        
+        dev = fz_new_draw_device(ctx_, fz_identity, pix);
+        fz_run_display_list(ctx_, list_, dev, transform, fz_infinite_rect, NULL);
+        fz_close_device(ctx_, dev);
+    }
+    fz_always(ctx_) {
+        if (dev) fz_drop_device(ctx_, dev);
+        if (pix) fz_drop_pixmap(ctx_, pix);
+    }
+    fz_catch(ctx_) {
+        throw std::runtime_error("MuPDF error rendering page " + std::to_string(page_index_ + 1));
+    }
+    
+    return img;
+}
+
+cv::Mat PDFPage::render_region(const fz_rect& area, int dpi) {
+    cv::Mat img;
+    fz_pixmap* pix = NULL;
+    fz_device* dev = NULL;
+    fz_var(pix);
+    fz_var(dev);
+    
+    fz_matrix transform = fz_scale(dpi / 72.0f, dpi / 72.0f);
+    fz_rect clipped = fz_intersect_rect(area, bounds_);
+    if (fz_is_empty_rect(clipped)) {
+        return img;
+    }
+    fz_irect bbox = fz_round_rect(fz_transform_rect(clipped, transform));
+    int width = bbox.x1 - bbox.x0;
+    int height = bbox.y1 - bbox.y0;
+    if (width <= 0 || height <= 0) {
+        return img;
+    }
+    
+    img.create(height, width, CV_8UC3);
+    
+    fz_try(ctx_) {
+        // The pixmap origin is the region's top-left, so only the region is drawn;
+        // the scissor lets the display list skip everything outside it
+        pix = fz_new_pixmap_with_bbox_and_data(ctx_, fz_device_bgr(ctx_), bbox, NULL, 0, img.data);
+        fz_clear_pixmap_with_value(ctx_, pix, 0xFF);
+        
+        dev = fz_new_draw_device(ctx_, fz_identity, pix);
+        fz_run_display_list(ctx_, list_, dev, transform, fz_rect_from_irect(bbox), NULL);
+        fz_close_device(ctx_, dev);
+    }
+    fz_always(ctx_) {
+        if (dev) fz_drop_device(ctx_, dev);
+        if (pix) fz_drop_pixmap(ctx_, pix);
+    }
+    fz_catch(ctx_) {
+        throw std::runtime_error("MuPDF error rendering region of page " + std::to_string(page_index_ + 1));
+    }
+    
+    return img;
+}
+
+cv::Size PDFPage::raster_size(int dpi) const {
+    fz_irect bbox = fz_round_rect(fz_transform_rect(bounds_, fz_scale(dpi / 72.0f, dpi / 72.0f)));
+    return cv::Size(std::max(0, bbox.x1 - bbox.x0), std::max(0, bbox.y1 - bbox.y0));
+}
+
+cv::Mat PDFPage::render_letterboxed(const cv::Size& target, cv::Rect2f& content) {
+    float page_width = bounds_.x1 - bounds_.x0;
+    float page_height = bounds_.y1 - bounds_.y0;
+    if (page_width <= 0 || page_height <= 0 || target.width <= 0 || target.height <= 0) {
+        return cv::Mat();
+    }
+    
+    // Largest zoom at which the whole page fits the target
+    float zoom = std::min(target.width / page_width, target.height / page_height);
+    fz_matrix transform = fz_scale(zoom, zoom);
+    fz_irect bbox = fz_round_rect(fz_transform_rect(bounds_, transform));
+    int width = std::min(bbox.x1 - bbox.x0, target.width);
+    int height = std::min(bbox.y1 - bbox.y0, target.height);
+    int pad_x = (target.width - width) / 2;
+    int pad_y = (target.height - height) / 2;
+    
+    // Letterbox padding uses the conventional YOLO gray
+    cv::Mat img(target, CV_8UC3, cv::Scalar(114, 114, 114));
+    
+    // Move the page's top-left corner to the pixmap origin
+    transform = fz_concat(transform, fz_translate(static_cast<float>(-bbox.x0), static_cast<float>(-bbox.y0)));
+    
+    fz_pixmap* pix = NULL;
+    fz_device* dev = NULL;
+    fz_var(pix);
+    fz_var(dev);
+    
+    fz_try(ctx_) {
+        // Draw in place into the content area of the padded image
+        pix = fz_new_pixmap_with_data(ctx_, fz_device_bgr(ctx_), width, height, NULL, 0,
+                                      static_cast<int>(img.step[0]), img.ptr(pad_y) + pad_x * 3);
+        fz_clear_pixmap_with_value(ctx_, pix, 0xFF);
+        
+        dev = fz_new_draw_device(ctx_, fz_identity, pix);
+        fz_run_display_list(ctx_, list_, dev, transform, fz_infinite_rect, NULL);
+        fz_close_device(ctx_, dev);
+    }
+    fz_always(ctx_) {
+        if (dev) fz_drop_device(ctx_, dev);
+        if (pix) fz_drop_pixmap(ctx_, pix);
+    }
+    fz_catch(ctx_) {
+        throw std::runtime_error("MuPDF error rendering page " + std::to_string(page_index_ + 1));
+    }
+    
+    content = cv::Rect2f(static_cast<float>(pad_x), static_cast<float>(pad_y),
+                         static_cast<float>(width), static_cast<float>(height));
+    return img;
+}
+
+fz_stext_page* PDFPage::text_layer() {
+    if (stext_loaded_) {
+        return stext_;
+    }
+    stext_loaded_ = true;
+    
+    fz_try(ctx_) {
+        // Extract structured text with default options
+        fz_stext_options opts = { 0 };
+        opts.flags = 0;
+        stext_ = fz_new_stext_page_from_display_list(ctx_, list_, &opts);
+    }
+    fz_catch(ctx_) {
+        std::cerr << "[ERROR] Text layer extraction failed for page " << (page_index_ + 1) << ": "
+                  << fz_caught_message(ctx_) << std::endl;
+        stext_ = NULL;
+    }
+    
+    return stext_;
+}
+
+std::string PDFPage::text_in_rect(const fz_rect& area) {
+    std::string text;
+    fz_stext_page* stext = text_layer();
+    if (!stext) {
+        return text;
+    }
+    
+    char* copied = NULL;
+    fz_try(ctx_) {
+        copied = fz_copy_rectangle(ctx_, stext, area, 0);
+    }
+    fz_catch(ctx_) {
+        return text;
+    }
+    
+    if (copied) {
+        text = copied;
+        fz_free(ctx_, copied);
+    }
+    return text;
+}
+
+#endif
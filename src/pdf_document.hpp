@@ -0,0 +1,92 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <memory>
+
+#ifdef USE_MUPDF
+#include <mupdf/fitz.h>
+
+class PDFPage;
+
+// A document session: one fz_document opened once per processing run and
+// shared by page rendering, structured-text extraction and metadata lookup.
+// Like the underlying fz_document, a session must only be used from the
+// thread that owns its fz_context.
+class PDFDocument {
+public:
+    // Throws std::runtime_error if the file cannot be opened
+    PDFDocument(fz_context* ctx, const std::string& pdf_path);
+    ~PDFDocument();
+    
+    PDFDocument(const PDFDocument&) = delete;
+    PDFDocument& operator=(const PDFDocument&) = delete;
+    
+    int page_count() const { return page_count_; }
+    const std::string& path() const { return path_; }
+    fz_context* context() const { return ctx_; }
+    
+    // Title from the document info dictionary, empty if there is none
+    std::string metadata_title() const;
+    
+    // Load a page once; its content stream is interpreted a single time into a
+    // display list that then serves rendering and text extraction
+    std::unique_ptr<PDFPage> load_page(int page_index);
+    
+private:
+    fz_context* ctx_;
+    fz_document* doc_ = nullptr;
+    std::string path_;
+    int page_count_ = 0;
+};
+
+// A page recorded into an fz_display_list. Raster and structured text are both
+// produced by replaying the list, so the PDF content stream is interpreted once.
+class PDFPage {
+public:
+    // Takes ownership of the display list
+    PDFPage(fz_context* ctx, fz_display_list* list, fz_rect bounds, int page_index);
+    ~PDFPage();
+    
+    PDFPage(const PDFPage&) = delete;
+    PDFPage& operator=(const PDFPage&) = delete;
+    
+    int index() const { return page_index_; }
+    
+    // Hand the page to another thread: from then on it is only used, and
+    // finally dropped, through ctx, which must be cloned from the same base
+    // context as the one it was loaded with. The document it came from must
+    // stay open until the page is dropped.
+    void set_context(fz_context* ctx) { ctx_ = ctx; }
+    fz_rect bounds() const { return bounds_; }
+    fz_display_list* display_list() const { return list_; }
+    
+    // Rasterize the page as a BGR image at the given resolution
+    cv::Mat render(int dpi);
+    
+    // Rasterize only area (in PDF points) at the given resolution, e.g. to OCR a
+    // region at a higher resolution than the page raster
+    cv::Mat render_region(const fz_rect& area, int dpi);
+    
+    // Size render(dpi) would produce
+    cv::Size raster_size(int dpi) const;
+    
+    // Rasterize the page scaled to fit target (aspect ratio kept) and centered on
+    // gray padding; content receives the area the page occupies
+    cv::Mat render_letterboxed(const cv::Size& target, cv::Rect2f& content);
+    
+    // Structured text of the page, built on first use and cached; null on failure
+    fz_stext_page* text_layer();
+    
+    // Text whose characters fall inside area (in PDF points), lines separated by '\n'
+    std::string text_in_rect(const fz_rect& area);
+    
+private:
+    fz_context* ctx_;
+    fz_display_list* list_;
+    fz_rect bounds_;
+    int page_index_;
+    fz_stext_page* stext_ = nullptr;
+    bool stext_loaded_ = false;
+};
+#endif
@@ -2,6 +2,10 @@
 #include "text_corrector.hpp"
 #include "heading_classifier.hpp" 
 #include "yolo_inference.h"
+#include "model_registry.hpp"
+#include "ocr_engine.hpp"
+#include "pdf_document.hpp"
+#include "result_cache.hpp"
 #include "utils.hpp"
 
 #include <opencv2/opencv.hpp>
@@ -13,61 +17,157 @@
 #include <algorithm>
 #include <cstdio>
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cctype>
+#include <map>
+#include <numeric>
 
 #ifdef USE_MUPDF
 #include <mupdf/fitz.h>
 #endif
 
-PDFProcessor::PDFProcessor() {
+struct PDFProcessor::PageWorker {
 #ifdef USE_MUPDF
-    // Initialize MuPDF context
-    fz_ctx_ = fz_new_context(NULL, NULL, FZ_STORE_UNLIMITED);
+    fz_context* ctx = nullptr;
+    PDFDocument* document = nullptr;
+    std::unique_ptr<PDFDocument> owned_document;
+    PDFPage* page = nullptr;  // Page being processed
+#endif
+    std::unique_ptr<YOLOInference::RunState> run_state;
+    utils::ObjectPool<OCREngine>::Lease ocr;
+};
+
+namespace {
+
+#ifdef USE_MUPDF
+void lock_fz_mutex(void* user, int lock) {
+    static_cast<std::mutex*>(user)[lock].lock();
+}
+
+void unlock_fz_mutex(void* user, int lock) {
+    static_cast<std::mutex*>(user)[lock].unlock();
+}
+#endif
+
+#ifdef USE_MUPDF
+// Map a rectangle in page raster pixels at dpi back to PDF points
+fz_rect raster_rect_to_points(const cv::Rect& rect, int dpi) {
+    float scale = dpi / 72.0f;
+    fz_rect area;
+    area.x0 = rect.x / scale;
+    area.y0 = rect.y / scale;
+    area.x1 = (rect.x + rect.width) / scale;
+    area.y1 = (rect.y + rect.height) / scale;
+    return area;
+}
+#endif
+
+std::mutex& log_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Busy time and input queue depth of one page pipeline stage
+struct StageStats {
+    std::atomic<int64_t> busy_ns{0};
+    std::atomic<int64_t> depth_sum{0};
+    std::atomic<int64_t> depth_samples{0};
+    
+    void add_busy(std::chrono::steady_clock::time_point start) {
+        busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    
+    void sample_depth(size_t depth) {
+        depth_sum += static_cast<int64_t>(depth);
+        depth_samples++;
+    }
+    
+    // Share of the workers' wall time spent working rather than waiting
+    double occupancy(int workers, int64_t wall_ns) const {
+        return workers > 0 && wall_ns > 0 ? static_cast<double>(busy_ns) / (static_cast<double>(workers) * wall_ns) : 0.0;
+    }
+    
+    double average_depth() const {
+        return depth_samples > 0 ? static_cast<double>(depth_sum) / depth_samples : 0.0;
+    }
+};
+
+std::string format_percent(double ratio) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%.0f%%", ratio * 100.0);
+    return buffer;
+}
+
+std::string format_depth(double depth) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%.1f", depth);
+    return buffer;
+}
+
+} // namespace
+
+PDFProcessor::PDFProcessor(const DetectorOptions& detector_options) {
+#ifdef USE_MUPDF
+    // Initialize MuPDF context with locking so page workers can clone it
+    fz_locks_.user = fz_mutexes_;
+    fz_locks_.lock = lock_fz_mutex;
+    fz_locks_.unlock = unlock_fz_mutex;
+    fz_ctx_ = fz_new_context(NULL, &fz_locks_, FZ_STORE_UNLIMITED);
     if (!fz_ctx_) {
         throw std::runtime_error("Failed to initialize MuPDF context");
     }
     fz_register_document_handlers(fz_ctx_);
 #endif
     
-    log_info("PDFProcessor initialized for sequential processing");
-    
-    // Initialize YOLO detector
-    yolo_detector_ = std::make_unique<YOLOInference>();
+    log_info("PDFProcessor initialized");
     
-    // Try to initialize with available models
+    // Initialize YOLO detector; the model is loaded once through the registry
+    // and shared with the heading classifier
     std::vector<std::string> model_paths = {
         "models/yolo_layout/",
         "models/PP-DocLayout-L/", 
         "models/PP-DocLayout-S/"
     };
     
-    bool yolo_initialized = false;
+    std::string detector_model_path;
     for (const auto& model_path : model_paths) {
-        if (yolo_detector_->initialize(model_path)) {
+        yolo_detector_ = ModelRegistry::instance().layout_detector(model_path, detector_options);
+        if (yolo_detector_) {
             log_info("YOLO layout detector initialized with: " + model_path);
-            yolo_initialized = true;
+            detector_model_path = model_path;
             break;
         }
     }
     
-    if (!yolo_initialized) {
+    if (!yolo_detector_) {
         log_info("YOLO not initialized - will use fallback detection");
     }
     
     // Initialize HeadingClassifier
     heading_classifier_ = std::make_unique<HeadingClassifier>();
-    if (heading_classifier_->initialize("models/yolo_layout/")) {
-        log_info("HeadingClassifier initialized successfully");
-    } else {
-        log_info("HeadingClassifier initialization failed - using basic patterns");
-    }
-    
-    // Initialize HeadingClassifier
-    heading_classifier_ = std::make_unique<HeadingClassifier>();
-    if (heading_classifier_->initialize("models/yolo_layout/")) {
+    if (heading_classifier_->initialize(detector_model_path.empty() ? "models/yolo_layout/" : detector_model_path,
+                                        detector_options)) {
         log_info("HeadingClassifier initialized successfully");
     } else {
         log_info("HeadingClassifier initialization failed - using basic classification");
     }
+    
+    // OCR engines are initialized once per worker and reused for every page and
+    // document; one is created up front for the sequential path.
+    ocr_pool_ = std::make_unique<utils::ObjectPool<OCREngine>>(1, [this]() {
+        auto engine = std::make_unique<OCREngine>();
+        if (engine->initialize("eng")) {
+            log_info("Tesseract OCR engine initialized");
+        } else {
+            log_error("Tesseract OCR engine initialization failed - OCR disabled");
+        }
+        return engine;
+    });
 }
 
 PDFProcessor::~PDFProcessor() {
@@ -78,6 +178,56 @@ PDFProcessor::~PDFProcessor() {
 #endif
 }
 
+void PDFProcessor::set_max_detections(int max_detections) {
+    if (yolo_detector_) {
+        yolo_detector_->set_max_detections(max_detections);
+    }
+}
+
+void PDFProcessor::set_result_cache(const std::string& directory, uint64_t max_bytes) {
+    if (directory.empty()) {
+        result_cache_.reset();
+        return;
+    }
+    if (result_cache_ && result_cache_->directory() == directory && result_cache_->max_bytes() == max_bytes) {
+        return;
+    }
+    
+    // Hashed once here rather than per document
+    std::string model_path = detector_model_path();
+    model_hash_ = model_path.empty() ? "none" : utils::hash_file(model_path);
+    result_cache_ = std::make_unique<ResultCache>(directory, max_bytes);
+    log_info("Result cache: " + directory + " (" + std::to_string(max_bytes / (1024 * 1024)) + " MB)");
+}
+
+std::string PDFProcessor::result_cache_key(const std::string& pdf_path) const {
+    std::string pdf_hash = utils::hash_file(pdf_path);
+    if (pdf_hash.empty()) {
+        return "";
+    }
+    
+    // Everything else that changes the output: version, classifier rules,
+    // layout model, the detector settings taken from its config.json and the
+    // settings in effect for this document
+    std::ostringstream config;
+    config << get_version() << '|' << HeadingClassifier::version() << '|' << model_hash_
+           << '|' << dpi_ << '|' << ocr_dpi_ << '|' << use_text_layer_ << '|' << render_for_detector_;
+    if (yolo_detector_) {
+        config << '|' << yolo_detector_->input_size().width << 'x' << yolo_detector_->input_size().height
+               << '|' << yolo_detector_->max_detections() << '|' << yolo_detector_->conf_threshold()
+               << '|' << yolo_detector_->nms_threshold();
+        for (const auto& name : yolo_detector_->class_names()) {
+            config << '|' << name;
+        }
+    }
+    std::string settings = config.str();
+    return pdf_hash + "-" + utils::to_hex(utils::fast_hash64(settings.data(), settings.size()));
+}
+
+std::string PDFProcessor::detector_model_path() const {
+    return yolo_detector_ ? yolo_detector_->model_path() : "";
+}
+
 ProcessingResult PDFProcessor::process_pdf(const std::string& pdf_path, const std::string& output_json) {
     auto start_time = std::chrono::high_resolution_clock::now();
     ProcessingResult result;
@@ -86,27 +236,49 @@ ProcessingResult PDFProcessor::process_pdf(const std::string& pdf_path, const st
     try {
         log_info("Processing PDF: " + pdf_path);
         
-        // Step 1: Convert PDF to images
-        TIME_BLOCK(pdf_conversion);
-        auto images = pdf_to_images(pdf_path);
-        TIME_END(pdf_conversion);
-        
-        if (images.empty()) {
-            result.error_message = "No pages could be converted from PDF";
-            return result;
+        if (!utils::file_exists(pdf_path)) {
+            throw std::runtime_error("PDF file not found: " + pdf_path);
         }
         
-        // Step 2: Extract title
-        result.title = extract_pdf_title(pdf_path);
-        
-        // Step 3: AI-powered heading detection (following 1.py workflow)
-        TIME_BLOCK(heading_detection);
-        current_pdf_path_ = pdf_path; // Store for table detection
-        result.headings = ai_detect_headings(images, result.title);
-        TIME_END(heading_detection);
+        // Step 0: The same bytes were already processed with the same settings
+        std::string cache_key = result_cache_ ? result_cache_key(pdf_path) : "";
+        std::string metadata_title;
+        if (!cache_key.empty() && result_cache_->load(cache_key, result, metadata_title)) {
+            result.title = extract_pdf_title(pdf_path, metadata_title);
+            log_info("Result cache hit: " + cache_key);
+        } else {
+#ifdef USE_MUPDF
+            // Step 1: Open the document once; the session serves metadata lookup,
+            // page rendering and structured-text extraction
+            PDFDocument document(fz_ctx_, pdf_path);
+            
+            // Step 2: Extract title
+            metadata_title = document.metadata_title();
+            result.title = extract_pdf_title(pdf_path, metadata_title);
+            
+            // Step 3: Stream pages through render -> AI heading detection (following 1.py workflow)
+            TIME_BLOCK(heading_detection);
+            int failed_pages = 0;
+            result.headings = ai_detect_headings(document, result.title, result.page_detection_ms, failed_pages);
+            TIME_END(heading_detection);
+            
+            // Headings lost to a page error would be missing from every later hit
+            if (!cache_key.empty() && failed_pages == 0) {
+                result_cache_->store(cache_key, result, metadata_title);
+            } else if (!cache_key.empty()) {
+                log_info("Not caching the result: " + std::to_string(failed_pages) + " page(s) failed");
+            }
+#else
+            // Fallback: This would require a different PDF library or external tool
+            log_error("MuPDF not available. PDF processing not implemented in fallback mode.");
+            throw std::runtime_error("PDF processing requires MuPDF library");
+#endif
+        }
         
-        // Step 4: Save results
-        save_results(result, output_json);
+        // Step 4: Save results (callers that only want the result pass no path)
+        if (!output_json.empty()) {
+            save_results(result, output_json);
+        }
         
         result.success = true;
         
@@ -123,97 +295,33 @@ ProcessingResult PDFProcessor::process_pdf(const std::string& pdf_path, const st
     return result;
 }
 
-std::vector<cv::Mat> PDFProcessor::pdf_to_images(const std::string& pdf_path) {
-    std::vector<cv::Mat> images;
-    
-    if (!utils::file_exists(pdf_path)) {
-        throw std::runtime_error("PDF file not found: " + pdf_path);
-    }
+std::vector<ProcessingResult> PDFProcessor::process_batch(
+    const std::vector<BatchItem>& items,
+    const std::function<void(size_t index, const ProcessingResult& result)>& on_file_done) {
+    std::vector<ProcessingResult> results(items.size());
     
 #ifdef USE_MUPDF
-    // Use MuPDF for optimal performance
-    fz_document* doc = NULL;
-    fz_page* page = NULL;
-    fz_pixmap* pix = NULL;
-    
-    fz_try(fz_ctx_) {
-        doc = fz_open_document(fz_ctx_, pdf_path.c_str());
-        int page_count = fz_count_pages(fz_ctx_, doc);
-        
-        log_info("Converting " + std::to_string(page_count) + " pages at " + std::to_string(dpi_) + " DPI");
-        
-        for (int i = 0; i < page_count; ++i) {
-            page = fz_load_page(fz_ctx_, doc, i);
-            
-            // Create transformation matrix for DPI
-            fz_matrix transform = fz_scale(dpi_ / 72.0f, dpi_ / 72.0f);
-            
-            // Render page to pixmap
-            pix = fz_new_pixmap_from_page(fz_ctx_, page, transform, fz_device_rgb(fz_ctx_), 0);
-            
-            // Convert to OpenCV Mat
-            int width = fz_pixmap_width(fz_ctx_, pix);
-            int height = fz_pixmap_height(fz_ctx_, pix);
-            int stride = fz_pixmap_stride(fz_ctx_, pix);
-            unsigned char* samples = fz_pixmap_samples(fz_ctx_, pix);
-            
-            // Create OpenCV Mat (RGB format)
-            cv::Mat img(height, width, CV_8UC3);
-            for (int y = 0; y < height; ++y) {
-                for (int x = 0; x < width; ++x) {
-                    int src_idx = y * stride + x * 3;
-                    int dst_idx = y * width * 3 + x * 3;
-                    img.data[dst_idx + 2] = samples[src_idx + 0]; // R
-                    img.data[dst_idx + 1] = samples[src_idx + 1]; // G  
-                    img.data[dst_idx + 0] = samples[src_idx + 2]; // B
-                }
-            }
-            
-            images.push_back(img.clone());
-            
-            fz_drop_pixmap(fz_ctx_, pix);
-            fz_drop_page(fz_ctx_, page);
-            pix = NULL;
-            page = NULL;
-        }
-    }
-    fz_always(fz_ctx_) {
-        if (pix) fz_drop_pixmap(fz_ctx_, pix);
-        if (page) fz_drop_page(fz_ctx_, page);
-        if (doc) fz_drop_document(fz_ctx_, doc);
+    // --pipeline overrides --jobs here too: files then go through it one by one
+    if (jobs_ > 1 && items.size() > 1 && !pipeline_enabled() && yolo_detector_ && yolo_detector_->is_initialized()) {
+        run_batch_scheduler(items, results, on_file_done);
+        return results;
     }
-    fz_catch(fz_ctx_) {
-        throw std::runtime_error("MuPDF error during PDF conversion");
-    }
-    
-#else
-    // Fallback: This would require a different PDF library or external tool
-    log_error("MuPDF not available. PDF processing not implemented in fallback mode.");
-    throw std::runtime_error("PDF processing requires MuPDF library");
 #endif
     
-    return images;
+    for (size_t i = 0; i < items.size(); ++i) {
+        results[i] = process_pdf(items[i].pdf_path, items[i].output_json);
+        if (on_file_done) on_file_done(i, results[i]);
+    }
+    return results;
 }
 
-std::string PDFProcessor::extract_pdf_title(const std::string& pdf_path) {
+std::string PDFProcessor::extract_pdf_title(const std::string& pdf_path, const std::string& metadata_title) {
     // Universal title extraction approach
     
-#ifdef USE_MUPDF
-    try {
-        fz_document* doc = fz_open_document(fz_ctx_, pdf_path.c_str());
-        if (doc) {
-            // Try PDF metadata first
-            char info[512];
-            if (fz_lookup_metadata(fz_ctx_, doc, FZ_META_INFO_TITLE, info, sizeof(info)) >= 0 && strlen(info) > 0) {
-                fz_drop_document(fz_ctx_, doc);
-                return std::string(info);
-            }
-            fz_drop_document(fz_ctx_, doc);
-        }
-    } catch (...) {
-        // Fallback if metadata fails
+    // Try PDF metadata first
+    if (!metadata_title.empty()) {
+        return metadata_title;
     }
-#endif
     
     // Fallback 1: Try to extract title from first page (largest/centered text)
     // This would require first page analysis - for now use filename
@@ -238,7 +346,7 @@ std::string PDFProcessor::extract_pdf_title(const std::string& pdf_path) {
     return result.empty() ? filename : result;
 }
 
-std::vector<HeadingInfo> PDFProcessor::detect_headings(const std::vector<cv::Mat>& images) {
+std::vector<HeadingInfo> PDFProcessor::detect_headings(int page_count) {
     std::vector<HeadingInfo> all_headings;
     
     // Initialize components
@@ -250,15 +358,15 @@ std::vector<HeadingInfo> PDFProcessor::detect_headings(const std::vector<cv::Mat
     }
 
     // Sequential processing only
-    log_info("Processing " + std::to_string(images.size()) + " pages sequentially");
+    log_info("Processing " + std::to_string(page_count) + " pages sequentially");
     
-    for (size_t i = 0; i < images.size(); ++i) {
+    for (int i = 0; i < page_count; ++i) {
         // TODO: Implement actual heading detection
         // For now, create dummy heading for testing
         HeadingInfo dummy;
         dummy.level = "H2";
         dummy.text = "Sample heading from page " + std::to_string(i + 1);
-        dummy.page_number = static_cast<int>(i + 1);
+        dummy.page_number = i + 1;
         dummy.confidence = 0.8;
         all_headings.push_back(dummy);
     }
@@ -275,11 +383,8 @@ void PDFProcessor::save_results(const ProcessingResult& result, const std::strin
         utils::ensure_directory_exists(parent_path);
     }
     
-    std::ofstream file(output_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open output file: " + output_path);
-    }
-    
+    // Built in memory and renamed into place, so a watcher never sees a partial file
+    std::ostringstream file;
     file << "{\n";
     file << "  \"title\": \"" << result.title << "\",\n";
     file << "  \"outline\": [\n";
@@ -298,47 +403,669 @@ void PDFProcessor::save_results(const ProcessingResult& result, const std::strin
     file << "  ]\n";
     file << "}\n";
     
-    file.close();
+    utils::write_file_atomic(output_path, file.str());
     log_info("Results saved to: " + output_path);
 }
 
 void PDFProcessor::log_error(const std::string& message) {
+    std::lock_guard<std::mutex> lock(log_mutex());
     std::cerr << "[ERROR] " << message << std::endl;
 }
 
 void PDFProcessor::log_info(const std::string& message) {
+    std::lock_guard<std::mutex> lock(log_mutex());
     std::cout << "[INFO] " << message << std::endl;
 }
 
 // AI-powered heading detection using YOLO layout detection
-std::vector<HeadingInfo> PDFProcessor::ai_detect_headings(const std::vector<cv::Mat>& images, const std::string& title) {
+std::vector<HeadingInfo> PDFProcessor::ai_detect_headings(PDFDocument& document, const std::string& title,
+                                                          std::vector<double>& page_detection_ms, int& failed_pages) {
     std::vector<HeadingInfo> all_headings;
+    failed_pages = 0;
+    
+#ifdef USE_MUPDF
+    int page_count = document.page_count();
+    if (page_count <= 0) {
+        throw std::runtime_error("No pages could be converted from PDF");
+    }
     
     if (!yolo_detector_ || !yolo_detector_->is_initialized()) {
         log_error("YOLO layout detector not available - falling back to basic detection");
-        return detect_headings(images); // Use fallback method
+        return detect_headings(page_count); // Use fallback method
     }
     
-    log_info("Using YOLO-powered layout detection for " + std::to_string(images.size()) + " pages");
+    log_info("Using YOLO-powered layout detection for " + std::to_string(page_count) + " pages");
+    log_info("Streaming pages at " + std::to_string(dpi_) + " DPI with up to " + 
+            std::to_string(max_inflight_pages_) + " page(s) in flight");
     
-    // Sequential processing only
-    log_info("Processing pages sequentially with YOLO inference");
+    // Results are collected per page and merged in page order afterwards,
+    // so the output does not depend on how pages were scheduled.
+    std::vector<PageResult> page_results(page_count);
     
-    for (size_t i = 0; i < images.size(); ++i) {
-        auto page_headings = process_single_page_ai(images[i], static_cast<int>(i + 1));
-        all_headings.insert(all_headings.end(), page_headings.begin(), page_headings.end());
+    if (pipeline_enabled() && page_count > 1) {
+        run_page_pipeline(document.path(), page_count, page_results);
+    } else if (jobs_ > 1 && page_count > 1) {
+        run_page_workers(document.path(), page_count, page_results);
+    } else {
+        log_info("Processing pages sequentially with YOLO inference");
+        PageWorker worker;
+        worker.ctx = fz_ctx_;
+        worker.document = &document;
+        worker.run_state = yolo_detector_->create_run_state();
+        worker.ocr = ocr_pool_->lease();
+        
+        // Render a window of pages, run them through the detector and drop the
+        // pixels before the next window is rendered, so peak memory is bounded
+        // by max_inflight_pages_ rather than by the document length.
+        for (int window_start = 0; window_start < page_count; window_start += max_inflight_pages_) {
+            int window_end = std::min(page_count, window_start + max_inflight_pages_);
+            process_page_window(worker, window_start, window_end, page_results);
+        }
     }
     
+    page_detection_ms.clear();
+    for (auto& page_result : page_results) {
+        all_headings.insert(all_headings.end(), page_result.headings.begin(), page_result.headings.end());
+        page_detection_ms.push_back(page_result.detection_ms);
+        if (page_result.failed) failed_pages++;
+    }
+#endif
+    
     log_info("Found " + std::to_string(all_headings.size()) + " headings using AI detection");
     return all_headings;
 }
 
-std::vector<HeadingInfo> PDFProcessor::process_single_page_ai(const cv::Mat& image, int page_number) {
+void PDFProcessor::process_page_window(PageWorker& worker, int window_start, int window_end,
+                                       std::vector<PageResult>& page_results) {
+#ifdef USE_MUPDF
+    // Each page is loaded once and shared by rendering and text extraction
+    std::vector<std::unique_ptr<PDFPage>> window_pages;
+    std::vector<PageImages> window_images;
+    window_pages.reserve(window_end - window_start);
+    window_images.reserve(window_end - window_start);
+    for (int i = window_start; i < window_end; ++i) {
+        window_pages.push_back(worker.document->load_page(i));
+        window_images.push_back(render_page_images(*window_pages.back()));
+    }
+    
+    // Run layout detection for the whole window in one batched inference
+    if (window_images.size() > 1 && yolo_detector_ && yolo_detector_->is_initialized()) {
+        std::vector<PageImages*> window;
+        for (auto& images : window_images) {
+            window.push_back(&images);
+        }
+        detect_window_layout(window, worker);
+    }
+    
+    for (size_t k = 0; k < window_images.size(); ++k) {
+        int page_index = window_start + static_cast<int>(k);
+        
+        worker.page = window_pages[k].get();
+        page_results[page_index].headings = process_single_page_ai(window_images[k], page_index + 1, worker,
+                                                                   page_results[page_index].failed);
+        page_results[page_index].detection_ms = window_images[k].detection_ms;
+        worker.page = nullptr;
+        
+        window_images[k] = PageImages();
+        window_pages[k].reset();
+    }
+#endif
+}
+
+PDFProcessor::PageImages PDFProcessor::render_page_images(PDFPage& page) {
+    PageImages images;
+#ifdef USE_MUPDF
+    images.page_size = page.raster_size(dpi_);
+    if (render_for_detector_) {
+        // Rasterize straight to the model input instead of resizing a dpi_ raster
+        images.detector_input = page.render_letterboxed(yolo_detector_->input_size(), images.detector_content);
+    } else {
+        images.page = page.render(dpi_);
+    }
+#endif
+    return images;
+}
+
+void PDFProcessor::ensure_page_raster(PageImages& images, PageWorker& worker) {
+#ifdef USE_MUPDF
+    if (images.page.empty() && worker.page) {
+        images.page = worker.page->render(dpi_);
+    }
+#endif
+}
+
+void PDFProcessor::run_page_workers(const std::string& pdf_path, int page_count,
+                                    std::vector<PageResult>& page_results) {
+#ifdef USE_MUPDF
+    int worker_count = std::min(jobs_, page_count);
+    
+    // Split the in-flight budget across workers; every worker holds at least one page
+    int window = std::max(1, max_inflight_pages_ / worker_count);
+    
+    log_info("Processing pages with " + std::to_string(worker_count) + " parallel workers");
+    
+    std::atomic<int> next_page{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+    
+    auto worker_main = [&](int worker_id) {
+        PageWorker worker;
+        worker.ctx = fz_clone_context(fz_ctx_);
+        if (!worker.ctx) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!first_error) {
+                first_error = std::make_exception_ptr(std::runtime_error("Failed to clone MuPDF context"));
+            }
+            failed = true;
+            return;
+        }
+        
+        try {
+            // fz_document is not thread-safe, so every worker opens its own session
+            worker.owned_document = std::make_unique<PDFDocument>(worker.ctx, pdf_path);
+            worker.document = worker.owned_document.get();
+            worker.run_state = yolo_detector_->create_run_state("page-worker-" + std::to_string(worker_id));
+            worker.ocr = ocr_pool_->lease();
+            
+            while (!failed) {
+                int window_start = next_page.fetch_add(window);
+                if (window_start >= page_count) break;
+                
+                int window_end = std::min(page_count, window_start + window);
+                process_page_window(worker, window_start, window_end, page_results);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!first_error) first_error = std::current_exception();
+            failed = true;
+        }
+        
+        worker.owned_document.reset();
+        fz_drop_context(worker.ctx);
+    };
+    
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count);
+    for (int w = 0; w < worker_count; ++w) {
+        threads.emplace_back(worker_main, w);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+#endif
+}
+
+void PDFProcessor::run_batch_scheduler(const std::vector<BatchItem>& items, std::vector<ProcessingResult>& results,
+                                       const std::function<void(size_t, const ProcessingResult&)>& on_file_done) {
+#ifdef USE_MUPDF
+    struct FileState {
+        std::chrono::steady_clock::time_point start;
+        std::vector<PageResult> page_results;
+        std::atomic<int> remaining_windows{0};
+        std::atomic<bool> done{false};
+        std::string cache_key;
+        std::string metadata_title;
+        bool cached = false;
+        std::mutex error_mutex;  // Guards the file's error_message while its windows run
+    };
+    
+    // A task either opens a file (window_start < 0), which queues the file's
+    // page windows, or processes one window of pages
+    struct Task {
+        int file_index = 0;
+        int window_start = -1;
+        int window_end = -1;
+    };
+    
+    int worker_count = jobs_;
+    int window = std::max(1, max_inflight_pages_ / worker_count);
+    
+    std::vector<FileState> files(items.size());
+    std::vector<utils::WorkStealingDeque<Task>> deques(worker_count);
+    std::atomic<int> pending{static_cast<int>(items.size())};  // Queued or running tasks
+    std::atomic<int> queued{static_cast<int>(items.size())};   // Tasks sitting in a deque
+    std::atomic<bool> failed{false};
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+    std::mutex done_mutex;
+    
+    // Workers with nothing to pop or steal sleep here until tasks are queued,
+    // the last task finishes or a worker fails
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+    auto wake_idle = [&]() {
+        // Taking the mutex orders the update before a waiter's predicate check
+        { std::lock_guard<std::mutex> lock(idle_mutex); }
+        idle_cv.notify_all();
+    };
+    auto task_done = [&]() {
+        if (--pending == 0) wake_idle();
+    };
+    
+    // Deal the files out largest first (by size on disk), so the long documents
+    // start right away and are split up while the short ones fill in around them
+    std::vector<size_t> order(items.size());
+    std::vector<uintmax_t> sizes(items.size(), 0);
+    for (size_t i = 0; i < items.size(); ++i) {
+        std::error_code ec;
+        uintmax_t size = std::filesystem::file_size(items[i].pdf_path, ec);
+        sizes[i] = ec ? 0 : size;
+    }
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+    for (size_t k = order.size(); k-- > 0;) {
+        // Owners pop from the back, so each deque is filled smallest first
+        deques[k % worker_count].push(Task{static_cast<int>(order[k]), -1, -1});
+    }
+    
+    log_info("Scheduling " + std::to_string(items.size()) + " files on " + std::to_string(worker_count) +
+            " workers in windows of " + std::to_string(window) + " page(s)");
+    
+    // Merges the pages of a finished file in page order and writes its output
+    auto finish_file = [&](int file_index) {
+        FileState& file = files[file_index];
+        ProcessingResult& result = results[file_index];
+        if (result.error_message.empty()) {
+            if (!file.cached) {
+                int failed_pages = 0;
+                for (auto& page_result : file.page_results) {
+                    result.headings.insert(result.headings.end(), page_result.headings.begin(), page_result.headings.end());
+                    result.page_detection_ms.push_back(page_result.detection_ms);
+                    if (page_result.failed) failed_pages++;
+                }
+                if (!file.cache_key.empty() && failed_pages == 0) {
+                    result_cache_->store(file.cache_key, result, file.metadata_title);
+                } else if (!file.cache_key.empty()) {
+                    log_info("Not caching the result for " + items[file_index].pdf_path + ": " +
+                            std::to_string(failed_pages) + " page(s) failed");
+                }
+            }
+            try {
+                save_results(result, items[file_index].output_json);
+                result.success = true;
+            } catch (const std::exception& e) {
+                result.error_message = e.what();
+            }
+        }
+        file.page_results = std::vector<PageResult>();
+        result.processing_time_seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - file.start).count();
+        
+        if (result.success) {
+            log_info("Processing completed successfully in " + std::to_string(result.processing_time_seconds) +
+                    "s: " + items[file_index].pdf_path);
+        } else {
+            log_error("Processing failed: " + items[file_index].pdf_path + ": " + result.error_message);
+        }
+        file.done = true;
+        
+        if (on_file_done) {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            on_file_done(static_cast<size_t>(file_index), result);
+        }
+    };
+    
+    auto worker_main = [&](int worker_id) {
+        PageWorker worker;
+        worker.ctx = fz_clone_context(fz_ctx_);
+        if (!worker.ctx) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!first_error) {
+                first_error = std::make_exception_ptr(std::runtime_error("Failed to clone MuPDF context"));
+            }
+            failed = true;
+            wake_idle();
+            return;
+        }
+        
+        // Document sessions this worker has open, by file; fz_document is not
+        // thread-safe, so every worker opens the files it works on itself
+        std::map<int, std::unique_ptr<PDFDocument>> sessions;
+        
+        try {
+            worker.run_state = yolo_detector_->create_run_state("batch-worker-" + std::to_string(worker_id));
+            worker.ocr = ocr_pool_->lease();
+            
+            while (!failed && pending > 0) {
+                Task task;
+                bool found = deques[worker_id].pop(task);
+                for (int k = 1; !found && k < worker_count; ++k) {
+                    found = deques[(worker_id + k) % worker_count].steal(task);
+                }
+                if (!found) {
+                    // Tasks still running elsewhere may queue more pages
+                    std::unique_lock<std::mutex> lock(idle_mutex);
+                    idle_cv.wait(lock, [&]() { return queued > 0 || pending == 0 || failed; });
+                    continue;
+                }
+                queued--;
+                
+                for (auto it = sessions.begin(); it != sessions.end();) {
+                    it = files[it->first].done ? sessions.erase(it) : std::next(it);
+                }
+                
+                FileState& file = files[task.file_index];
+                const std::string& pdf_path = items[task.file_index].pdf_path;
+                
+                if (task.window_start < 0) {
+                    file.start = std::chrono::steady_clock::now();
+                    log_info("Processing PDF: " + pdf_path);
+                    try {
+                        if (!utils::file_exists(pdf_path)) {
+                            throw std::runtime_error("PDF file not found: " + pdf_path);
+                        }
+                        
+                        // Same bytes and settings as an earlier run: nothing to render
+                        file.cache_key = result_cache_ ? result_cache_key(pdf_path) : "";
+                        if (!file.cache_key.empty() &&
+                            result_cache_->load(file.cache_key, results[task.file_index], file.metadata_title)) {
+                            results[task.file_index].title = extract_pdf_title(pdf_path, file.metadata_title);
+                            file.cached = true;
+                            log_info("Result cache hit: " + file.cache_key);
+                            finish_file(task.file_index);
+                            task_done();
+                            continue;
+                        }
+                        
+                        auto document = std::make_unique<PDFDocument>(worker.ctx, pdf_path);
+                        int page_count = document->page_count();
+                        if (page_count <= 0) {
+                            throw std::runtime_error("No pages could be converted from PDF");
+                        }
+                        file.metadata_title = document->metadata_title();
+                        results[task.file_index].title = extract_pdf_title(pdf_path, file.metadata_title);
+                        sessions[task.file_index] = std::move(document);
+                        
+                        int windows = (page_count + window - 1) / window;
+                        file.page_results.resize(page_count);
+                        file.remaining_windows = windows;
+                        pending += windows;
+                        queued += windows;
+                        
+                        // Queued last window first: this worker continues from the
+                        // first page while thieves take the end of the file
+                        for (int start = (windows - 1) * window; start >= 0; start -= window) {
+                            deques[worker_id].push(Task{task.file_index, start, std::min(page_count, start + window)});
+                        }
+                        wake_idle();
+                    } catch (const std::exception& e) {
+                        results[task.file_index].error_message = e.what();
+                        finish_file(task.file_index);
+                    }
+                } else {
+                    try {
+                        auto& session = sessions[task.file_index];
+                        if (!session) {
+                            session = std::make_unique<PDFDocument>(worker.ctx, pdf_path);
+                        }
+                        worker.document = session.get();
+                        process_page_window(worker, task.window_start, task.window_end, file.page_results);
+                    } catch (const std::exception& e) {
+                        // Fails the whole file, as it would outside a batch
+                        std::lock_guard<std::mutex> lock(file.error_mutex);
+                        if (results[task.file_index].error_message.empty()) {
+                            results[task.file_index].error_message = "Error processing pages " +
+                                std::to_string(task.window_start + 1) + "-" + std::to_string(task.window_end) +
+                                ": " + e.what();
+                        }
+                    }
+                    worker.document = nullptr;
+                    
+                    if (--file.remaining_windows == 0) {
+                        finish_file(task.file_index);
+                    }
+                }
+                
+                task_done();
+            }
+        } catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error) first_error = std::current_exception();
+            }
+            failed = true;
+            wake_idle();
+        }
+        
+        sessions.clear();
+        fz_drop_context(worker.ctx);
+    };
+    
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count);
+    for (int w = 0; w < worker_count; ++w) {
+        threads.emplace_back(worker_main, w);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+#endif
+}
+
+void PDFProcessor::run_page_pipeline(const std::string& pdf_path, int page_count,
+                                     std::vector<PageResult>& page_results) {
+#ifdef USE_MUPDF
+    struct PageTask {
+        int page_index = 0;
+        std::unique_ptr<PDFPage> page;  // Recorded once, by the render stage
+        PageImages images;
+    };
+    using Task = std::unique_ptr<PageTask>;
+    
+    int render_workers = std::min(pipeline_render_workers_, page_count);
+    int detect_workers = std::min(pipeline_detect_workers_, page_count);
+    int ocr_workers = std::min(pipeline_ocr_workers_, page_count);
+    
+    // Each queue holds at most max_inflight_pages_ pages, so a slow stage stalls
+    // the stages in front of it instead of letting rendered pages pile up
+    size_t queue_capacity = static_cast<size_t>(std::max(2, max_inflight_pages_));
+    utils::BoundedQueue<Task> rendered(queue_capacity);
+    utils::BoundedQueue<Task> detected(queue_capacity);
+    
+    log_info("Pipelining pages through " + std::to_string(render_workers) + " render, " +
+            std::to_string(detect_workers) + " detect and " + std::to_string(ocr_workers) +
+            " OCR worker(s), " + std::to_string(queue_capacity) + " page(s) per queue");
+    
+    std::atomic<int> next_page{0};
+    std::atomic<int> render_running{render_workers};
+    std::atomic<int> detect_running{detect_workers};
+    std::atomic<bool> failed{false};
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+    StageStats render_stats, detect_stats, ocr_stats;
+    
+    // As on the other paths, an error on any page fails the document, so it
+    // stops every stage
+    auto fail = [&](std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!first_error) first_error = error;
+        }
+        failed = true;
+        rendered.close();
+        detected.close();
+    };
+    
+    // fz_document is not thread-safe, so every render worker opens its own
+    // session. A page is loaded there once and travels through the stages with
+    // its display list and structured text; whoever holds it rebinds it to
+    // their own cloned context. Pages refer to their document and context until
+    // dropped, so all worker state is kept until every stage has stopped.
+    std::vector<PageWorker> render_state(render_workers);
+    std::vector<PageWorker> detect_state(detect_workers);
+    std::vector<PageWorker> ocr_state(ocr_workers);
+    
+    auto clone_context = [&](PageWorker& worker) {
+        worker.ctx = fz_clone_context(fz_ctx_);
+        if (!worker.ctx) {
+            throw std::runtime_error("Failed to clone MuPDF context");
+        }
+    };
+    auto close_session = [](PageWorker& worker) {
+        worker.owned_document.reset();
+        if (worker.ctx) fz_drop_context(worker.ctx);
+        worker.ctx = nullptr;
+    };
+    
+    auto render_main = [&](int worker_id) {
+        PageWorker& worker = render_state[worker_id];
+        try {
+            clone_context(worker);
+            worker.owned_document = std::make_unique<PDFDocument>(worker.ctx, pdf_path);
+            worker.document = worker.owned_document.get();
+            while (!failed) {
+                int page_index = next_page.fetch_add(1);
+                if (page_index >= page_count) break;
+                
+                auto busy_start = std::chrono::steady_clock::now();
+                Task task = std::make_unique<PageTask>();
+                task->page_index = page_index;
+                task->page = worker.document->load_page(page_index);
+                task->images = render_page_images(*task->page);
+                
+                // Extracted here as well, so the OCR stage only looks text up
+                task->page->text_layer();
+                render_stats.add_busy(busy_start);
+                
+                // Blocks while the detect stage is behind
+                if (!rendered.push(task)) break;
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        if (--render_running == 0) rendered.close();
+    };
+    
+    auto detect_main = [&](int worker_id) {
+        PageWorker& worker = detect_state[worker_id];
+        try {
+            clone_context(worker);
+            worker.run_state = yolo_detector_->create_run_state("pipeline-detect-" + std::to_string(worker_id));
+            Task task;
+            while (!failed && rendered.pop(task)) {
+                detect_stats.sample_depth(rendered.size() + 1);
+                
+                // Batch whatever else is already rendered, up to max_inflight_pages_
+                std::vector<Task> batch;
+                batch.push_back(std::move(task));
+                while (static_cast<int>(batch.size()) < max_inflight_pages_ && rendered.try_pop(task)) {
+                    batch.push_back(std::move(task));
+                }
+                
+                auto busy_start = std::chrono::steady_clock::now();
+                std::vector<PageImages*> window;
+                for (auto& item : batch) {
+                    item->page->set_context(worker.ctx);
+                    window.push_back(&item->images);
+                }
+                detect_window_layout(window, worker);
+                detect_stats.add_busy(busy_start);
+                
+                // Blocks while the OCR stage is behind
+                for (auto& item : batch) {
+                    if (!detected.push(item)) break;
+                }
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        if (--detect_running == 0) detected.close();
+    };
+    
+    auto ocr_main = [&](int worker_id) {
+        PageWorker& worker = ocr_state[worker_id];
+        try {
+            clone_context(worker);
+            worker.ocr = ocr_pool_->lease();
+            Task task;
+            while (!failed && detected.pop(task)) {
+                ocr_stats.sample_depth(detected.size() + 1);
+                
+                auto busy_start = std::chrono::steady_clock::now();
+                int page_index = task->page_index;
+                task->page->set_context(worker.ctx);
+                worker.page = task->page.get();
+                page_results[page_index].headings = process_single_page_ai(task->images, page_index + 1, worker,
+                                                                           page_results[page_index].failed);
+                page_results[page_index].detection_ms = task->images.detection_ms;
+                worker.page = nullptr;
+                task.reset();
+                ocr_stats.add_busy(busy_start);
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        worker.page = nullptr;
+        worker.ocr.reset();
+    };
+    
+    auto wall_start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    threads.reserve(render_workers + detect_workers + ocr_workers);
+    for (int w = 0; w < render_workers; ++w) {
+        threads.emplace_back(render_main, w);
+    }
+    for (int w = 0; w < detect_workers; ++w) {
+        threads.emplace_back(detect_main, w);
+    }
+    for (int w = 0; w < ocr_workers; ++w) {
+        threads.emplace_back(ocr_main, w);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    int64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - wall_start).count();
+    
+    // Pages left queued after a failure still use the workers' contexts
+    Task leftover;
+    while (rendered.try_pop(leftover)) leftover.reset();
+    while (detected.try_pop(leftover)) leftover.reset();
+    for (auto* stage : {&render_state, &detect_state, &ocr_state}) {
+        for (auto& worker : *stage) {
+            close_session(worker);
+        }
+    }
+    
+    // Occupancy tells which stage is the bottleneck: it runs near 100% busy,
+    // the queue in front of it stays full and the stages before it block on it
+    log_info("Pipeline render: " + std::to_string(render_workers) + " worker(s), " +
+            format_percent(render_stats.occupancy(render_workers, wall_ns)) + " busy, blocked on a full queue " +
+            std::to_string(rendered.full_waits()) + " time(s)");
+    log_info("Pipeline detect: " + std::to_string(detect_workers) + " worker(s), " +
+            format_percent(detect_stats.occupancy(detect_workers, wall_ns)) + " busy, input queue depth " +
+            format_depth(detect_stats.average_depth()) + "/" + std::to_string(queue_capacity) +
+            ", blocked on a full queue " + std::to_string(detected.full_waits()) + " time(s)");
+    log_info("Pipeline OCR: " + std::to_string(ocr_workers) + " worker(s), " +
+            format_percent(ocr_stats.occupancy(ocr_workers, wall_ns)) + " busy, input queue depth " +
+            format_depth(ocr_stats.average_depth()) + "/" + std::to_string(queue_capacity));
+    
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+#endif
+}
+
+std::vector<HeadingInfo> PDFProcessor::process_single_page_ai(PageImages& images, int page_number, PageWorker& worker,
+                                                              bool& page_failed) {
     std::vector<HeadingInfo> page_headings;
     
+    // Tracks whether the OCR engine holds an image that must be released, also
+    // when the page fails, so the leased engine goes back to the pool clean
+    bool ocr_page_set = false;
+    
     try {
-        // Step 1: Detect tables on this page using MuPDF  
-        std::vector<cv::Rect> table_regions = detect_tables_on_page(current_pdf_path_, page_number);
+        // Step 1: Detect tables on this page using the MuPDF text layer
+        std::vector<cv::Rect> table_regions = detect_tables_on_page(worker, page_number);
         
         // Step 2: YOLO Layout Detection 
         if (!yolo_detector_ || !yolo_detector_->is_initialized()) {
@@ -346,12 +1073,23 @@ std::vector<HeadingInfo> PDFProcessor::process_single_page_ai(const cv::Mat& ima
             return page_headings;
         }
         
-        // Get YOLO layout detection results
-        auto layout_detections = yolo_detector_->detect_layout(image);
+        // Get YOLO layout detection results, in page raster coordinates
+        if (!images.layout_detected) {
+            detect_page_layout(images, worker);
+        }
+        std::vector<BBox> layout_detections = std::move(images.layout);
+        if (images.detection_failed) {
+            // Mock regions still yield headings, but the result must not be cached
+            log_error("Page " + std::to_string(page_number) + ": layout detection failed, using fallback regions");
+            page_failed = true;
+        }
         
         log_info("Page " + std::to_string(page_number) + ": YOLO detected " + 
                 std::to_string(layout_detections.size()) + " layout regions");
         
+        int text_layer_regions = 0;
+        int ocr_regions = 0;
+        
         // Step 3: Process each detected heading region, skipping tables
         for (const auto& detection : layout_detections) {
             // Convert BBox to cv::Rect
@@ -368,16 +1106,33 @@ std::vector<HeadingInfo> PDFProcessor::process_single_page_ai(const cv::Mat& ima
             // Only process title, paragraph_title, and text regions (potential headings)
             if (detection.label == "title" || detection.label == "paragraph_title" || detection.label == "text") {
                 // Step 4: Crop heading region from image
-                cv::Rect safe_bbox = bbox & cv::Rect(0, 0, image.cols, image.rows);
+                cv::Rect safe_bbox = bbox & cv::Rect(0, 0, images.page_size.width, images.page_size.height);
                 if (safe_bbox.width <= 0 || safe_bbox.height <= 0) continue;
                 
-                // Step 5: OCR text extraction using Tesseract (like Python)
-                std::string extracted_text = crop_and_ocr_text(image, safe_bbox);
+                // Step 5: Take the text from the embedded text layer when the PDF has one,
+                // and only fall back to OCR (in-process Tesseract) for regions without it
+                std::string extracted_text;
+                bool from_text_layer = false;
+                if (use_text_layer_) {
+                    extracted_text = extract_text_layer(worker, safe_bbox);
+                    from_text_layer = !extracted_text.empty();
+                }
+                if (!from_text_layer) {
+                    if (!worker.ocr) continue;
+                    extracted_text = ocr_heading_region(images, worker, safe_bbox, ocr_page_set);
+                    ocr_regions++;
+                } else {
+                    text_layer_regions++;
+                }
 
                 if (!extracted_text.empty() && extracted_text.length() > 2) {
-                    // Step 6: T5 text correction (currently simplified)
-                    TextCorrector corrector;
-                    std::string corrected_text = corrector.correct_text(extracted_text);
+                    // Step 6: T5 text correction (currently simplified); text layer
+                    // content is exact and is not run through OCR error fixes
+                    std::string corrected_text = extracted_text;
+                    if (!from_text_layer) {
+                        TextCorrector corrector;
+                        corrected_text = corrector.correct_text(extracted_text);
+                    }
                     
                     // Step 6.5: Apply basic heading restrictions
                     // Count words in the corrected text
@@ -431,183 +1186,259 @@ std::vector<HeadingInfo> PDFProcessor::process_single_page_ai(const cv::Mat& ima
             }
         }
         
+        if (ocr_page_set) {
+            worker.ocr->clear_page();
+        }
+        
+        log_info("Page " + std::to_string(page_number) + ": " + std::to_string(text_layer_regions) + 
+                " region(s) from text layer, " + std::to_string(ocr_regions) + " via OCR");
+        
     } catch (const std::exception& e) {
         log_error("Error processing page " + std::to_string(page_number) + ": " + e.what());
+        page_failed = true;
+        if (ocr_page_set) {
+            worker.ocr->clear_page();
+        }
     }
     
     return page_headings;
 }
 
-std::string PDFProcessor::crop_and_ocr_text(const cv::Mat& image, const cv::Rect& bbox) {
-    try {
-        // Step 1: Crop the region
-        cv::Mat cropped = image(bbox);
-        
-        if (cropped.empty()) {
-            return "";
+void PDFProcessor::detect_page_layout(PageImages& images, PageWorker& worker) {
+    auto detect_start = std::chrono::high_resolution_clock::now();
+    if (!worker.run_state) {
+        worker.run_state = yolo_detector_->create_run_state();
+    }
+    size_t fallbacks_before = worker.run_state->fallback_images;
+    if (!images.detector_input.empty()) {
+        images.layout = yolo_detector_->detect_layout_letterboxed(
+            images.detector_input, images.detector_content, images.page_size, worker.run_state.get());
+    } else {
+        images.layout = yolo_detector_->detect_layout(images.page, worker.run_state.get());
+    }
+    images.layout_detected = true;
+    images.detection_failed = worker.run_state->fallback_images != fallbacks_before;
+    images.detection_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - detect_start).count();
+}
+
+void PDFProcessor::detect_window_layout(const std::vector<PageImages*>& window, PageWorker& worker) {
+    if (window.size() == 1) {
+        detect_page_layout(*window[0], worker);
+        return;
+    }
+    
+    // Run layout detection for the whole window in one batched inference
+    auto detect_start = std::chrono::high_resolution_clock::now();
+    size_t fallbacks_before = worker.run_state->fallback_images;
+    std::vector<std::vector<BBox>> window_layout;
+    if (render_for_detector_) {
+        std::vector<cv::Mat> inputs;
+        std::vector<cv::Rect2f> contents;
+        std::vector<cv::Size> target_sizes;
+        for (const PageImages* images : window) {
+            inputs.push_back(images->detector_input);
+            contents.push_back(images->detector_content);
+            target_sizes.push_back(images->page_size);
         }
-        
-        // Step 2: Save cropped image temporarily for Tesseract
-        std::string temp_crop = "/tmp/temp_crop_" + std::to_string(std::rand()) + ".png";
-        cv::imwrite(temp_crop, cropped);
-        
-        // Step 3: Use Tesseract OCR (system call - matching Python behavior)
-        std::string command = "tesseract " + temp_crop + " stdout --psm 6 2>/dev/null";
-        
-        FILE* pipe = popen(command.c_str(), "r");
-        if (!pipe) {
-            std::remove(temp_crop.c_str());
-            return "";
+        window_layout = yolo_detector_->detect_layout_letterboxed_batch(
+            inputs, contents, target_sizes, worker.run_state.get());
+    } else {
+        std::vector<cv::Mat> inputs;
+        for (const PageImages* images : window) {
+            inputs.push_back(images->page);
         }
-        
-        std::string result;
-        char buffer[256];
-        while (fgets(buffer, sizeof(buffer), pipe)) {
-            result += buffer;
+        window_layout = yolo_detector_->detect_layout_batch(inputs, worker.run_state.get());
+    }
+    
+    // A batched run is attributed evenly to its pages
+    double window_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - detect_start).count();
+    
+    // The run does not say which images fell back, so a fallback counts
+    // against every page of the window
+    bool detection_failed = worker.run_state->fallback_images != fallbacks_before;
+    for (size_t k = 0; k < window.size(); ++k) {
+        window[k]->layout = std::move(window_layout[k]);
+        window[k]->layout_detected = true;
+        window[k]->detection_failed = detection_failed;
+        window[k]->detection_ms = window_ms / window.size();
+    }
+}
+
+std::string PDFProcessor::ocr_heading_region(PageImages& images, PageWorker& worker, const cv::Rect& bbox, bool& ocr_page_set) {
+#ifdef USE_MUPDF
+    // Re-render just the heading box from the vector page at the OCR resolution,
+    // so layout detection can stay at a low DPI without starving OCR of pixels
+    if (ocr_dpi_ > 0 && worker.page) {
+        cv::Mat region = worker.page->render_region(raster_rect_to_points(bbox, dpi_), ocr_dpi_);
+        if (region.empty()) {
+            return "";
         }
-        pclose(pipe);
-        
-        // Step 4: Clean up temporary file
-        std::remove(temp_crop.c_str());
+        worker.ocr->set_page(region, ocr_dpi_);
+        ocr_page_set = true;
+        return ocr_region(*worker.ocr, cv::Rect(0, 0, region.cols, region.rows)).text;
+    }
+#endif
+    
+    // OCR in place on the page raster; the page is handed to the engine once,
+    // on the first region that needs it
+    if (!ocr_page_set) {
+        ensure_page_raster(images, worker);
+        worker.ocr->set_page(images.page, dpi_);
+        ocr_page_set = true;
+    }
+    return ocr_region(*worker.ocr, bbox).text;
+}
+
+OCRResult PDFProcessor::ocr_region(OCREngine& ocr, const cv::Rect& bbox) {
+    try {
+        // Recognize the region in place on the page set on the engine
+        OCRResult result = ocr.recognize(bbox);
+        std::string& text = result.text;
         
-        // Step 5: Clean text (remove extra whitespace, newlines)
-        result.erase(std::remove(result.begin(), result.end(), '\n'), result.end());
-        result.erase(std::remove(result.begin(), result.end(), '\r'), result.end());
+        // Clean text (remove extra whitespace, newlines)
+        text.erase(std::remove(text.begin(), text.end(), '\n'), text.end());
+        text.erase(std::remove(text.begin(), text.end(), '\r'), text.end());
         
         // Trim whitespace
-        size_t start = result.find_first_not_of(" \t");
-        if (start == std::string::npos) return "";
-        size_t end = result.find_last_not_of(" \t");
-        result = result.substr(start, end - start + 1);
+        size_t start = text.find_first_not_of(" \t");
+        if (start == std::string::npos) {
+            text.clear();
+            return result;
+        }
+        size_t end = text.find_last_not_of(" \t");
+        text = text.substr(start, end - start + 1);
         
         return result;
         
     } catch (const std::exception& e) {
         log_error("OCR error: " + std::string(e.what()));
+        return OCRResult();
+    }
+}
+
+std::string PDFProcessor::extract_text_layer(const PageWorker& worker, const cv::Rect& bbox) {
+    std::string text;
+    
+#ifdef USE_MUPDF
+    if (!worker.page) {
+        return text;
+    }
+    
+    // Map the box from page raster pixels back to PDF points
+    text = worker.page->text_in_rect(raster_rect_to_points(bbox, dpi_));
+    
+    // Glyphs without a Unicode mapping come out as U+FFFD; such regions have
+    // no usable text layer and must go through OCR instead
+    if (text.find("\xEF\xBF\xBD") != std::string::npos) {
         return "";
     }
+    
+    // Join lines and collapse runs of whitespace
+    std::string normalized;
+    normalized.reserve(text.size());
+    bool pending_space = false;
+    for (char c : text) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pending_space = !normalized.empty();
+        } else {
+            if (pending_space) normalized += ' ';
+            normalized += c;
+            pending_space = false;
+        }
+    }
+    text = normalized;
+#endif
+    
+    return text;
 }
 
 // Table detection using MuPDF structured text analysis
-std::vector<cv::Rect> PDFProcessor::detect_tables_on_page(const std::string& pdf_path, int page_number) {
+std::vector<cv::Rect> PDFProcessor::detect_tables_on_page(const PageWorker& worker, int page_number) {
     std::vector<cv::Rect> table_regions;
     
 #ifdef USE_MUPDF
-    fz_document* doc = NULL;
-    fz_page* page = NULL;
-    fz_stext_page* stext = NULL;
-    
-    // Use a separate context for table detection to avoid stack issues
-    fz_context* table_ctx = fz_new_context(NULL, NULL, FZ_STORE_UNLIMITED);
-    if (!table_ctx) {
-        log_error("Failed to create MuPDF context for table detection");
+    fz_stext_page* stext = worker.page ? worker.page->text_layer() : nullptr;
+    if (!stext) {
         return table_regions;
     }
     
-    fz_try(table_ctx) {
-        fz_register_document_handlers(table_ctx);
-        doc = fz_open_document(table_ctx, pdf_path.c_str());
-        
-        if (page_number - 1 >= fz_count_pages(table_ctx, doc)) {
-            log_error("Page number out of range for table detection");
-            fz_drop_document(table_ctx, doc);
-            fz_drop_context(table_ctx);
-            return table_regions;
-        }
-        
-        page = fz_load_page(table_ctx, doc, page_number - 1); // Convert to 0-based index
-        
-        // Extract structured text with simplified options
-        fz_stext_options opts = { 0 };
-        opts.flags = 0; // Use default flags
-        stext = fz_new_stext_page_from_page(table_ctx, page, &opts);
-        
-        // Simplified table detection: look for rectangular text arrangements
-        // This is a basic implementation - real table detection would be more sophisticated
+    // Simplified table detection: look for rectangular text arrangements
+    // This is a basic implementation - real table detection would be more sophisticated
+    
+    std::vector<fz_rect> text_blocks;
+    
+    // Collect all text block positions
+    for (fz_stext_block* block = stext->first_block; block; block = block->next) {
+        if (block->type != FZ_STEXT_BLOCK_TEXT) continue;
         
-        std::vector<fz_rect> text_blocks;
+        // Get bounding box of the entire text block
+        fz_rect block_bbox = block->bbox;
+        text_blocks.push_back(block_bbox);
+    }
+    
+    // Simple heuristic: if we find many small, aligned text blocks, 
+    // they might form a table
+    if (text_blocks.size() >= 6) { // At least 6 text blocks for a potential table
+        // Look for alignment patterns
+        const float alignment_tolerance = 10.0f; // pixels
         
-        // Collect all text block positions
-        for (fz_stext_block* block = stext->first_block; block; block = block->next) {
-            if (block->type != FZ_STEXT_BLOCK_TEXT) continue;
-            
-            // Get bounding box of the entire text block
-            fz_rect block_bbox = block->bbox;
-            text_blocks.push_back(block_bbox);
-        }
+        // Group blocks by similar X positions (columns)
+        std::vector<std::vector<fz_rect>> columns;
         
-        // Simple heuristic: if we find many small, aligned text blocks, 
-        // they might form a table
-        if (text_blocks.size() >= 6) { // At least 6 text blocks for a potential table
-            // Look for alignment patterns
-            const float alignment_tolerance = 10.0f; // pixels
-            
-            // Group blocks by similar X positions (columns)
-            std::vector<std::vector<fz_rect>> columns;
+        for (const auto& block : text_blocks) {
+            bool found_column = false;
             
-            for (const auto& block : text_blocks) {
-                bool found_column = false;
-                
-                for (auto& column : columns) {
-                    if (!column.empty()) {
-                        float x_diff = std::abs(column[0].x0 - block.x0);
-                        if (x_diff < alignment_tolerance) {
-                            column.push_back(block);
-                            found_column = true;
-                            break;
-                        }
+            for (auto& column : columns) {
+                if (!column.empty()) {
+                    float x_diff = std::abs(column[0].x0 - block.x0);
+                    if (x_diff < alignment_tolerance) {
+                        column.push_back(block);
+                        found_column = true;
+                        break;
                     }
                 }
-                
-                if (!found_column) {
-                    columns.push_back({block});
-                }
             }
             
-            // If we have 2+ columns with 2+ blocks each, it might be a table
-            int valid_columns = 0;
-            for (const auto& column : columns) {
-                if (column.size() >= 2) {
-                    valid_columns++;
-                }
+            if (!found_column) {
+                columns.push_back({block});
             }
-            
-            if (valid_columns >= 2) {
-                // Create a table region encompassing all these blocks
-                float min_x = 1000000, min_y = 1000000;
-                float max_x = 0, max_y = 0;
-                
-                for (const auto& block : text_blocks) {
-                    min_x = std::min(min_x, block.x0);
-                    min_y = std::min(min_y, block.y0);
-                    max_x = std::max(max_x, block.x1);
-                    max_y = std::max(max_y, block.y1);
-                }
-                
-                // Convert to OpenCV Rect (scale to match image coordinates)
-                float scale = dpi_ / 72.0f;
-                cv::Rect table_rect(
-                    static_cast<int>(min_x * scale),
-                    static_cast<int>(min_y * scale),
-                    static_cast<int>((max_x - min_x) * scale),
-                    static_cast<int>((max_y - min_y) * scale)
-                );
-                
-                table_regions.push_back(table_rect);
+        }
+        
+        // If we have 2+ columns with 2+ blocks each, it might be a table
+        int valid_columns = 0;
+        for (const auto& column : columns) {
+            if (column.size() >= 2) {
+                valid_columns++;
             }
         }
         
-    } fz_catch(table_ctx) {
-        log_error("Table detection failed for page " + std::to_string(page_number) + ": " + 
-                 std::string(fz_caught_message(table_ctx)));
+        if (valid_columns >= 2) {
+            // Create a table region encompassing all these blocks
+            float min_x = 1000000, min_y = 1000000;
+            float max_x = 0, max_y = 0;
+            
+            for (const auto& block : text_blocks) {
+                min_x = std::min(min_x, block.x0);
+                min_y = std::min(min_y, block.y0);
+                max_x = std::max(max_x, block.x1);
+                max_y = std::max(max_y, block.y1);
+            }
+            
+            // Convert to OpenCV Rect (scale to match image coordinates)
+            float scale = dpi_ / 72.0f;
+            cv::Rect table_rect(
+                static_cast<int>(min_x * scale),
+                static_cast<int>(min_y * scale),
+                static_cast<int>((max_x - min_x) * scale),
+                static_cast<int>((max_y - min_y) * scale)
+            );
+            
+            table_regions.push_back(table_rect);
+        }
     }
     
-    // Clean up resources
-    if (stext) fz_drop_stext_page(table_ctx, stext);
-    if (page) fz_drop_page(table_ctx, page);
-    if (doc) fz_drop_document(table_ctx, doc);
-    fz_drop_context(table_ctx);
-    
 #else
     // Fallback: no table detection without MuPDF
     log_info("MuPDF not available - skipping table detection for page " + std::to_string(page_number));
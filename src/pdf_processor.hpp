@@ -4,6 +4,12 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <mutex>
+#include <functional>
+
+#include "utils.hpp"
+#include "common_types.h"
 
 #ifdef USE_MUPDF
 #include <mupdf/fitz.h>
@@ -12,6 +18,11 @@
 // Forward declarations
 class YOLOInference;
 class HeadingClassifier;
+class OCREngine;
+struct OCRResult;
+class PDFDocument;
+class PDFPage;
+class ResultCache;
 
 struct HeadingInfo {
     std::string level;  // "H1", "H2", "H3"
@@ -27,56 +38,164 @@ struct ProcessingResult {
     bool success;
     std::string error_message;
     double processing_time_seconds;
+    std::vector<double> page_detection_ms;  // Layout detection time per page
+};
+
+// One file of a batch and where its results go
+struct BatchItem {
+    std::string pdf_path;
+    std::string output_json;
 };
 
 class PDFProcessor {
 public:
-    PDFProcessor();
+    // Detector options are needed up front because models load here
+    explicit PDFProcessor(const DetectorOptions& detector_options = DetectorOptions());
     ~PDFProcessor();
     
-    // Main processing function
+    // Main processing function; an empty output_json skips writing the file
     ProcessingResult process_pdf(const std::string& pdf_path, 
                                const std::string& output_json = "output/heading_schema.json");
     
+    // Process several PDFs as one batch. With more than one job (and no
+    // pipeline), workers take (file, page window) tasks from work-stealing
+    // deques, so a long document does not hold up short ones behind it and no
+    // core idles at the tail of a file. on_file_done is called (one call at a
+    // time) as soon as the last page of a file finishes; results are returned
+    // in input order.
+    std::vector<ProcessingResult> process_batch(
+        const std::vector<BatchItem>& items,
+        const std::function<void(size_t index, const ProcessingResult& result)>& on_file_done = nullptr);
+    
+    // Rendering resolutions accepted for dpi and ocr_dpi; the setters clamp to
+    // them (ocr_dpi may also be 0)
+    static constexpr int MIN_DPI = 36;
+    static constexpr int MAX_DPI = 600;
+    
     // Configuration options
-    void set_dpi(int dpi) { dpi_ = dpi; }
+    void set_dpi(int dpi) { dpi_ = std::clamp(dpi, MIN_DPI, MAX_DPI); }
+    void set_max_inflight_pages(int pages) { max_inflight_pages_ = std::max(1, pages); }
+    void set_jobs(int jobs) { jobs_ = std::max(1, jobs); }
+    void set_use_text_layer(bool enabled) { use_text_layer_ = enabled; }
+    void set_render_for_detector(bool enabled) { render_for_detector_ = enabled; }
+    void set_ocr_dpi(int dpi) { ocr_dpi_ = std::clamp(dpi, 0, MAX_DPI); }
+    void set_max_detections(int max_detections);
+    int dpi() const { return dpi_; }
+    int ocr_dpi() const { return ocr_dpi_; }
+    bool use_text_layer() const { return use_text_layer_; }
+    
+    // Run pages through separate render, detect and OCR stages connected by
+    // bounded queues; all three counts must be positive, 0 turns it off
+    void set_pipeline_workers(int render, int detect, int ocr) {
+        pipeline_render_workers_ = std::max(0, render);
+        pipeline_detect_workers_ = std::max(0, detect);
+        pipeline_ocr_workers_ = std::max(0, ocr);
+    }
+    bool pipeline_enabled() const {
+        return pipeline_render_workers_ > 0 && pipeline_detect_workers_ > 0 && pipeline_ocr_workers_ > 0;
+    }
+    
+    // Reuse results for PDFs whose bytes and settings match an earlier run, from
+    // an on-disk cache bounded to max_bytes; an empty directory turns it off
+    void set_result_cache(const std::string& directory, uint64_t max_bytes);
+    
+    // Layout model in use (empty when running the fallback detector)
+    std::string detector_model_path() const;
     
     // Utility functions
     static std::string get_version() { return "1.0.0"; }
     
 private:
+    // Per-thread page processing state (MuPDF context clone, document handle,
+    // inference run state); defined in pdf_processor.cpp
+    struct PageWorker;
+    
+    // Rasters of one page. In detector-size render mode only the letterboxed
+    // model input is rendered up front; the dpi_ raster is rendered on demand
+    // when a region has to be OCRed.
+    struct PageImages {
+        cv::Mat page;                 // Page at dpi_, may be empty until OCR needs it
+        cv::Size page_size;           // Size of the page raster at dpi_
+        cv::Mat detector_input;       // Letterboxed model input (detector-size mode only)
+        cv::Rect2f detector_content;  // Page area inside detector_input
+        std::vector<BBox> layout;     // Layout detections when run for the whole window
+        bool layout_detected = false;
+        bool detection_failed = false;  // Inference failed and layout holds mock regions
+        double detection_ms = 0.0;    // Time spent in layout detection for this page
+    };
+    
+    struct PageResult {
+        std::vector<HeadingInfo> headings;
+        double detection_ms = 0.0;
+        bool failed = false;  // An error cut the page short; the document is then not cached
+    };
+    
     // Core processing steps
-    std::vector<cv::Mat> pdf_to_images(const std::string& pdf_path);
-    std::string extract_pdf_title(const std::string& pdf_path);
-    std::vector<HeadingInfo> detect_headings(const std::vector<cv::Mat>& images);
+    std::string extract_pdf_title(const std::string& pdf_path, const std::string& metadata_title);
+    std::vector<HeadingInfo> detect_headings(int page_count);
     
-    // AI-powered heading detection (following 1.py workflow)
-    std::vector<HeadingInfo> ai_detect_headings(const std::vector<cv::Mat>& images, const std::string& title);
-    std::vector<HeadingInfo> process_single_page_ai(const cv::Mat& image, int page_number);
-    std::string crop_and_ocr_text(const cv::Mat& image, const cv::Rect& bbox);
+    // AI-powered heading detection (following 1.py workflow).
+    // Pages are streamed: each window of rendered pages is processed and
+    // released before the next window is rendered.
+    std::vector<HeadingInfo> ai_detect_headings(PDFDocument& document, const std::string& title,
+                                                std::vector<double>& page_detection_ms, int& failed_pages);
+    void process_page_window(PageWorker& worker, int window_start, int window_end,
+                             std::vector<PageResult>& page_results);
+    void run_page_workers(const std::string& pdf_path, int page_count,
+                          std::vector<PageResult>& page_results);
+    void run_batch_scheduler(const std::vector<BatchItem>& items, std::vector<ProcessingResult>& results,
+                             const std::function<void(size_t, const ProcessingResult&)>& on_file_done);
+    void run_page_pipeline(const std::string& pdf_path, int page_count,
+                           std::vector<PageResult>& page_results);
+    PageImages render_page_images(PDFPage& page);
+    void detect_page_layout(PageImages& images, PageWorker& worker);
+    void detect_window_layout(const std::vector<PageImages*>& window, PageWorker& worker);
+    std::vector<HeadingInfo> process_single_page_ai(PageImages& images, int page_number, PageWorker& worker,
+                                                    bool& page_failed);
+    void ensure_page_raster(PageImages& images, PageWorker& worker);
+    std::string ocr_heading_region(PageImages& images, PageWorker& worker, const cv::Rect& bbox, bool& ocr_page_set);
+    OCRResult ocr_region(OCREngine& ocr, const cv::Rect& bbox);
     
-    // Table detection using MuPDF
-    std::vector<cv::Rect> detect_tables_on_page(const std::string& pdf_path, int page_number);
+    // Embedded text layer (born-digital PDFs) and table detection using MuPDF
+    std::string extract_text_layer(const PageWorker& worker, const cv::Rect& bbox);
+    std::vector<cv::Rect> detect_tables_on_page(const PageWorker& worker, int page_number);
     bool is_region_overlapping_table(const cv::Rect& region, const std::vector<cv::Rect>& table_regions);
     
     void save_results(const ProcessingResult& result, const std::string& output_path);
+    std::string result_cache_key(const std::string& pdf_path) const;
     
     // Configuration
     int dpi_ = 100;  // Optimized for speed
+    int ocr_dpi_ = 300;  // OCR regions are re-rendered at this DPI (0 = crop the page raster)
+    int max_inflight_pages_ = 1;  // Rendered pages held in memory at once
+    int jobs_ = 1;                // Page worker threads
+    bool use_text_layer_ = true;  // Prefer embedded PDF text over OCR
+    bool render_for_detector_ = false;  // Render pages at the detector input size
+    int pipeline_render_workers_ = 0;   // Pipeline stage workers (0 = pipeline off)
+    int pipeline_detect_workers_ = 0;
+    int pipeline_ocr_workers_ = 0;
     
     // Internal state
 #ifdef USE_MUPDF
     fz_context* fz_ctx_ = nullptr;
+    
+    // Locking so page workers can clone fz_ctx_
+    std::mutex fz_mutexes_[FZ_LOCK_MAX];
+    fz_locks_context fz_locks_;
 #endif
     
     // YOLO inference for layout detection
-    std::unique_ptr<YOLOInference> yolo_detector_;
+    std::shared_ptr<YOLOInference> yolo_detector_;
     
     // Heading classification
     std::unique_ptr<HeadingClassifier> heading_classifier_;
     
-    // Current PDF path for table detection
-    std::string current_pdf_path_;
+    // Results of earlier runs, keyed by PDF contents and settings
+    std::unique_ptr<ResultCache> result_cache_;
+    std::string model_hash_;  // Layout model contents, part of the cache key
+    
+    // Initialized OCR engines, leased to page workers and kept warm across documents
+    std::unique_ptr<utils::ObjectPool<OCREngine>> ocr_pool_;
     
     // Error handling
     void log_error(const std::string& message);
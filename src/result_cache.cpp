@@ -0,0 +1,175 @@
+#include "result_cache.hpp"
+#include "pdf_processor.hpp"
+#include "utils.hpp"
+
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Bumped when the entry layout changes
+constexpr int ENTRY_FORMAT = 1;
+
+// Exclusive flock on the cache directory's lock file, held for its lifetime
+class DirectoryLock {
+public:
+    explicit DirectoryLock(const std::string& directory) {
+        std::string path = (std::filesystem::path(directory) / ".lock").string();
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ >= 0 && flock(fd_, LOCK_EX) != 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    ~DirectoryLock() {
+        if (fd_ >= 0) {
+            flock(fd_, LOCK_UN);
+            close(fd_);
+        }
+    }
+
+    DirectoryLock(const DirectoryLock&) = delete;
+    DirectoryLock& operator=(const DirectoryLock&) = delete;
+
+    bool locked() const { return fd_ >= 0; }
+
+private:
+    int fd_ = -1;
+};
+
+} // namespace
+
+ResultCache::ResultCache(const std::string& directory, uint64_t max_bytes)
+    : directory_(directory), max_bytes_(max_bytes) {
+    utils::ensure_directory_exists(directory_);
+}
+
+std::string ResultCache::entry_path(const std::string& key) const {
+    return (std::filesystem::path(directory_) / (key + ".json")).string();
+}
+
+bool ResultCache::load(const std::string& key, ProcessingResult& result, std::string& metadata_title) {
+    // No lock needed: entries only ever appear by rename, and an entry evicted
+    // while it is being read stays readable through the open file
+    std::string path = entry_path(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    try {
+        json entry = json::parse(file);
+        if (entry.value("format", 0) != ENTRY_FORMAT) {
+            return false;
+        }
+
+        metadata_title = entry.value("metadata_title", "");
+        result.headings.clear();
+        for (const auto& item : entry.at("headings")) {
+            HeadingInfo heading;
+            heading.level = item.at("level").get<std::string>();
+            heading.text = item.at("text").get<std::string>();
+            heading.page_number = item.at("page").get<int>();
+            const auto& box = item.at("bbox");
+            heading.bounding_box = cv::Rect(box.at(0).get<int>(), box.at(1).get<int>(),
+                                            box.at(2).get<int>(), box.at(3).get<int>());
+            heading.confidence = item.at("confidence").get<double>();
+            result.headings.push_back(heading);
+        }
+        result.page_detection_ms = entry.value("page_detection_ms", std::vector<double>());
+    } catch (const std::exception& e) {
+        std::cerr << "⚠️ Dropping unreadable result cache entry " << path << ": " << e.what() << std::endl;
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        return false;
+    }
+
+    // The mtime is the LRU clock
+    std::error_code ec;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void ResultCache::store(const std::string& key, const ProcessingResult& result, const std::string& metadata_title) {
+    json headings = json::array();
+    for (const auto& heading : result.headings) {
+        const cv::Rect& box = heading.bounding_box;
+        headings.push_back({
+            {"level", heading.level},
+            {"text", heading.text},
+            {"page", heading.page_number},
+            {"bbox", {box.x, box.y, box.width, box.height}},
+            {"confidence", heading.confidence}
+        });
+    }
+    json entry = {
+        {"format", ENTRY_FORMAT},
+        {"metadata_title", metadata_title},
+        {"headings", headings},
+        {"page_detection_ms", result.page_detection_ms}
+    };
+
+    try {
+        DirectoryLock lock(directory_);
+        if (!lock.locked()) {
+            std::cerr << "⚠️ Result cache: cannot lock " << directory_ << ", not storing" << std::endl;
+            return;
+        }
+        utils::write_file_atomic(entry_path(key), entry.dump());
+        evict_locked();
+    } catch (const std::exception& e) {
+        std::cerr << "⚠️ Result cache: cannot store entry: " << e.what() << std::endl;
+    }
+}
+
+void ResultCache::evict_locked() {
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_used;
+        uint64_t size;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, ec)) {
+        std::string name = item.path().filename().string();
+        if (name.empty() || name[0] == '.' || item.path().extension() != ".json") continue;
+
+        std::error_code entry_ec;
+        uint64_t size = item.file_size(entry_ec);
+        auto last_used = item.last_write_time(entry_ec);
+        if (entry_ec) continue;
+        entries.push_back({item.path(), last_used, size});
+        total += size;
+    }
+    if (total <= max_bytes_) {
+        return;
+    }
+
+    // Least recently used first
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+    size_t removed = 0;
+    for (const auto& entry : entries) {
+        if (total <= max_bytes_) break;
+        if (std::filesystem::remove(entry.path, ec)) {
+            total -= entry.size;
+            removed++;
+        }
+    }
+    std::cout << "🧹 Result cache: evicted " << removed << " entr" << (removed == 1 ? "y" : "ies")
+              << ", " << total / (1024 * 1024) << " MB in use" << std::endl;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+struct ProcessingResult;
+
+// On-disk cache of processing results, keyed by content (see
+// PDFProcessor::result_cache_key). One JSON file per entry; hits refresh the
+// entry's mtime and the least recently used entries are evicted once the
+// directory grows past max_bytes. Entries are written atomically and stores
+// and evictions take an flock on the directory, so several processes can
+// share one cache directory.
+class ResultCache {
+public:
+    ResultCache(const std::string& directory, uint64_t max_bytes);
+
+    // The title is not cached as such: it may come from the file name, which
+    // differs between copies, so the PDF's metadata title is stored instead
+    bool load(const std::string& key, ProcessingResult& result, std::string& metadata_title);
+    void store(const std::string& key, const ProcessingResult& result, const std::string& metadata_title);
+
+    const std::string& directory() const { return directory_; }
+    uint64_t max_bytes() const { return max_bytes_; }
+
+private:
+    std::string entry_path(const std::string& key) const;
+    void evict_locked();
+
+    std::string directory_;
+    uint64_t max_bytes_;
+};
@@ -4,9 +4,52 @@
 #include <sstream>
 #include <cctype>
 #include <vector>
+#include <fstream>
+#include <cstring>
+#include <atomic>
+#include <stdexcept>
+#include <unistd.h>
 
 namespace utils {
 
+namespace {
+
+// XXH64 primes and helpers
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+} // namespace
+
 bool file_exists(const std::string& path) {
     return std::filesystem::exists(path);
 }
@@ -20,6 +63,37 @@ void ensure_directory_exists(const std::string& path) {
     std::filesystem::create_directories(path);
 }
 
+void write_file_atomic(const std::string& path, const std::string& content) {
+    static std::atomic<unsigned> counter{0};
+    
+    // Hidden, unique temporary name: not picked up as an input or output, and
+    // concurrent writers (threads or processes) never share one
+    std::filesystem::path target(path);
+    std::filesystem::path temp = target.parent_path() /
+        ("." + target.filename().string() + ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++));
+    
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Cannot open output file: " + temp.string());
+        }
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+        file.close();
+        if (!file) {
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            throw std::runtime_error("Cannot write output file: " + temp.string());
+        }
+    }
+    
+    std::error_code ec;
+    std::filesystem::rename(temp, target, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        throw std::runtime_error("Cannot move output file into place: " + path);
+    }
+}
+
 std::string trim(const std::string& str) {
     auto start = str.begin();
     while (start != str.end() && std::isspace(*start)) {
@@ -122,4 +196,94 @@ bool contains_mostly_letters(const std::string& text, double threshold) {
     return static_cast<double>(letter_count) / text.length() >= threshold;
 }
 
+// XXH64 (little-endian hosts)
+uint64_t fast_hash64(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t h;
+    
+    if (size >= 32) {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const unsigned char* limit = end - 32;
+        do {
+            v1 = xxh64_round(v1, read64(p)); p += 8;
+            v2 = xxh64_round(v2, read64(p)); p += 8;
+            v3 = xxh64_round(v3, read64(p)); p += 8;
+            v4 = xxh64_round(v4, read64(p)); p += 8;
+        } while (p <= limit);
+        
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge_round(h, v1);
+        h = xxh64_merge_round(h, v2);
+        h = xxh64_merge_round(h, v3);
+        h = xxh64_merge_round(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    
+    h += static_cast<uint64_t>(size);
+    
+    while (p + 8 <= end) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        ++p;
+    }
+    
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+std::string to_hex(uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        hex[i] = digits[value & 0xF];
+        value >>= 4;
+    }
+    return hex;
+}
+
+std::string hash_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return "";
+    }
+    
+    // Fixed-size chunks, each seeded with the hash so far, so large files are
+    // hashed in constant memory and the result does not depend on read sizes
+    const size_t chunk_size = 4 << 20;
+    std::vector<char> buffer(chunk_size);
+    uint64_t hash = 0;
+    uint64_t total = 0;
+    while (file) {
+        file.read(buffer.data(), buffer.size());
+        std::streamsize got = file.gcount();
+        if (got <= 0) break;
+        hash = fast_hash64(buffer.data(), static_cast<size_t>(got), hash);
+        total += static_cast<uint64_t>(got);
+    }
+    if (file.bad()) {
+        return "";
+    }
+    
+    return to_hex(fast_hash64(&total, sizeof(total), hash));
+}
+
 } // namespace utils
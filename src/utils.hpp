@@ -6,6 +6,13 @@
 #include <filesystem>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <deque>
 
 // Utility macros for timing
 #define TIME_BLOCK(name) auto start_##name = std::chrono::high_resolution_clock::now()
@@ -21,6 +28,9 @@ namespace utils {
     bool file_exists(const std::string& path);
     std::string get_filename_without_extension(const std::string& path);
     void ensure_directory_exists(const std::string& path);
+    // Writes through a temporary file in the same directory and renames it into
+    // place, so readers see either the old file or the complete new one
+    void write_file_atomic(const std::string& path, const std::string& content);
     
     // String utilities
     std::string trim(const std::string& str);
@@ -29,6 +39,12 @@ namespace utils {
     bool starts_with(const std::string& str, const std::string& prefix);
     bool ends_with(const std::string& str, const std::string& suffix);
     
+    // Hashing utilities (fast, non-cryptographic; for cache keys)
+    uint64_t fast_hash64(const void* data, size_t size, uint64_t seed = 0);
+    std::string to_hex(uint64_t value);
+    // Hex hash of a file's contents, or an empty string if it cannot be read
+    std::string hash_file(const std::string& path);
+    
     // Validation utilities
     bool is_valid_heading_text(const std::string& text);
     bool contains_mostly_letters(const std::string& text, double threshold = 0.5);
@@ -57,34 +73,261 @@ namespace utils {
     };
     
     // Memory utilities
+    
+    // Thread-safe pool of reusable objects. Objects are created by the factory
+    // (default-constructed unless one is given), so expensive-to-initialize
+    // resources are built once and then handed from caller to caller.
     template<typename T>
     class ObjectPool {
     public:
-        ObjectPool(size_t initial_size = 10) {
+        using Factory = std::function<std::unique_ptr<T>()>;
+        
+        // RAII handle that returns its object to the pool when destroyed
+        class Lease {
+        public:
+            Lease() = default;
+            Lease(ObjectPool* pool, std::unique_ptr<T> obj) : pool_(pool), obj_(std::move(obj)) {}
+            Lease(Lease&& other) noexcept = default;
+            Lease& operator=(Lease&& other) noexcept {
+                if (this != &other) {
+                    reset();
+                    pool_ = other.pool_;
+                    obj_ = std::move(other.obj_);
+                }
+                return *this;
+            }
+            ~Lease() { reset(); }
+            
+            T* get() const { return obj_.get(); }
+            T& operator*() const { return *obj_; }
+            T* operator->() const { return obj_.get(); }
+            explicit operator bool() const { return obj_ != nullptr; }
+            
+            void reset() {
+                if (pool_ && obj_) {
+                    pool_->release(std::move(obj_));
+                }
+                obj_.reset();
+            }
+            
+        private:
+            ObjectPool* pool_ = nullptr;
+            std::unique_ptr<T> obj_;
+        };
+        
+        ObjectPool(size_t initial_size = 10, Factory factory = nullptr)
+            : factory_(factory ? std::move(factory) : Factory([] { return std::make_unique<T>(); })) {
             for (size_t i = 0; i < initial_size; ++i) {
-                available_.push_back(std::make_unique<T>());
+                available_.push_back(factory_());
             }
         }
         
         std::unique_ptr<T> acquire() {
-            if (available_.empty()) {
-                return std::make_unique<T>();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!available_.empty()) {
+                    auto obj = std::move(available_.back());
+                    available_.pop_back();
+                    return obj;
+                }
             }
             
-            auto obj = std::move(available_.back());
-            available_.pop_back();
-            return obj;
+            // Create outside the lock so concurrent callers initialize in parallel
+            return factory_();
+        }
+        
+        Lease lease() {
+            return Lease(this, acquire());
         }
         
         void release(std::unique_ptr<T> obj) {
+            if (!obj) return;
+            std::lock_guard<std::mutex> lock(mutex_);
             if (available_.size() < max_pool_size_) {
                 available_.push_back(std::move(obj));
             }
         }
         
+        size_t available() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return available_.size();
+        }
+        
     private:
+        Factory factory_;
+        mutable std::mutex mutex_;
         std::vector<std::unique_ptr<T>> available_;
         static constexpr size_t max_pool_size_ = 50;
     };
     
+    // Bounded lock-free multi-producer/multi-consumer queue (Vyukov's ring
+    // buffer). try_push/try_pop never block; push/pop wait with backoff, which
+    // is what gives a pipeline its backpressure. After close(), push fails and
+    // pop drains what is left, then fails.
+    template<typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity)
+            : capacity_(std::max<size_t>(2, capacity)) {
+            size_t size = 1;
+            while (size < capacity_) size <<= 1;
+            mask_ = size - 1;
+            cells_ = std::make_unique<Cell[]>(size);
+            for (size_t i = 0; i < size; ++i) {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+        
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+        
+        bool try_push(T& value) {
+            size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            for (;;) {
+                // The ring may be larger than the requested capacity; the bound
+                // is enforced on the number of queued items
+                size_t dequeued = dequeue_pos_.load(std::memory_order_acquire);
+                if (pos < dequeued) {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (pos - dequeued >= capacity_) {
+                    return false;
+                }
+                Cell& cell = cells_[pos & mask_];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        cell.value = std::move(value);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+        
+        bool try_pop(T& value) {
+            size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell& cell = cells_[pos & mask_];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        value = std::move(cell.value);
+                        cell.value = T();
+                        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+        
+        // Blocking push; returns false (leaving value untouched) once closed.
+        // Counts the times the queue was found full.
+        bool push(T& value) {
+            bool waited = false;
+            for (unsigned spins = 0;; ++spins) {
+                if (closed_.load(std::memory_order_acquire)) return false;
+                if (try_push(value)) return true;
+                if (!waited) {
+                    full_waits_.fetch_add(1, std::memory_order_relaxed);
+                    waited = true;
+                }
+                backoff(spins);
+            }
+        }
+        
+        // Blocking pop; returns false once the queue is closed and drained
+        bool pop(T& value) {
+            for (unsigned spins = 0;; ++spins) {
+                if (try_pop(value)) return true;
+                if (closed_.load(std::memory_order_acquire)) {
+                    return try_pop(value);
+                }
+                backoff(spins);
+            }
+        }
+        
+        void close() { closed_.store(true, std::memory_order_release); }
+        bool closed() const { return closed_.load(std::memory_order_acquire); }
+        
+        // Approximate number of queued items
+        size_t size() const {
+            size_t enqueued = enqueue_pos_.load(std::memory_order_acquire);
+            size_t dequeued = dequeue_pos_.load(std::memory_order_acquire);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+        size_t capacity() const { return capacity_; }
+        size_t full_waits() const { return full_waits_.load(std::memory_order_relaxed); }
+        
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+        
+        static void backoff(unsigned spins) {
+            if (spins < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        
+        size_t capacity_;
+        size_t mask_;
+        std::unique_ptr<Cell[]> cells_;
+        alignas(64) std::atomic<size_t> enqueue_pos_{0};
+        alignas(64) std::atomic<size_t> dequeue_pos_{0};
+        std::atomic<bool> closed_{false};
+        std::atomic<size_t> full_waits_{0};
+    };
+    
+    // Per-worker task deque for work stealing: the owner pushes and pops at the
+    // back, idle workers steal from the front. Tasks are whole pages, so a
+    // mutex per deque costs nothing measurable next to the work itself.
+    template<typename T>
+    class WorkStealingDeque {
+    public:
+        void push(T value) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            items_.push_back(std::move(value));
+        }
+        
+        bool pop(T& value) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (items_.empty()) return false;
+            value = std::move(items_.back());
+            items_.pop_back();
+            return true;
+        }
+        
+        bool steal(T& value) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (items_.empty()) return false;
+            value = std::move(items_.front());
+            items_.pop_front();
+            return true;
+        }
+        
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return items_.size();
+        }
+        
+    private:
+        mutable std::mutex mutex_;
+        std::deque<T> items_;
+    };
+    
 } // namespace utils
@@ -1,18 +1,46 @@
 #include "yolo_inference.h"
+#include "utils.hpp"
 #include <iostream>
 #include <fstream>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
-YOLOInference::YOLOInference() 
-    : initialized_(false), conf_threshold_(0.5f), nms_threshold_(0.45f)
+namespace {
+
+// Raw score whose sigmoid equals p, so thresholds can be tested without exp
+float logit(float p) {
+    if (p <= 0.0f) return -std::numeric_limits<float>::infinity();
+    if (p >= 1.0f) return std::numeric_limits<float>::infinity();
+    return std::log(p / (1.0f - p));
+}
+
+}  // namespace
+
+YOLOInference::YOLOInference(const DetectorOptions& options) 
+    : initialized_(false), options_(options), input_size_(1024, 1024),
+      nms_threshold_(0.45f), max_detections_(0)
 {
+    if (options_.input_size > 0) {
+        input_size_ = cv::Size(options_.input_size, options_.input_size);
+    }
+    set_conf_threshold(0.5f);
     class_names_ = DEFAULT_CLASSES;
 }
 
+void YOLOInference::set_conf_threshold(float threshold) {
+    conf_threshold_ = threshold;
+    conf_logit_ = logit(threshold);
+}
+
 YOLOInference::~YOLOInference() {
 #ifdef USE_ONNX_RUNTIME
     // RAII will handle cleanup
@@ -29,11 +57,33 @@ bool YOLOInference::initialize(const std::string& model_dir) {
         "yolov12.onnx"
     };
     
+    // A requested input size prefers a model exported at that size
+    if (options_.input_size > 0) {
+        onnx_names.insert(onnx_names.begin(), "yolo_layout_" + std::to_string(options_.input_size) + ".onnx");
+    }
+    
+    // INT8 exports (static or dynamic quantization) sit next to the FP32 ones
+    if (options_.int8) {
+        std::vector<std::string> int8_names = {"yolo_layout_int8.onnx"};
+        if (options_.input_size > 0) {
+            int8_names.insert(int8_names.begin(), "yolo_layout_" + std::to_string(options_.input_size) + "_int8.onnx");
+        }
+        bool found_int8 = false;
+        for (const auto& name : int8_names) {
+            found_int8 = found_int8 || std::ifstream(model_dir + "/" + name).good();
+        }
+        if (!found_int8) {
+            std::cout << "⚠️ No INT8 layout model in " << model_dir << ", using FP32" << std::endl;
+        }
+        onnx_names.insert(onnx_names.begin(), int8_names.begin(), int8_names.end());
+    }
+    
     for (const auto& name : onnx_names) {
         std::string onnx_path = model_dir + "/" + name;
         std::ifstream onnx_check(onnx_path);
         if (onnx_check.good()) {
             std::cout << "✅ Found YOLO ONNX model: " << onnx_path << std::endl;
+            model_path_ = onnx_path;
             std::string config_path = model_dir + "/config.json";
             return initialize_onnx(onnx_path, config_path);
         }
@@ -54,15 +104,14 @@ bool YOLOInference::initialize(const std::string& model_dir) {
 #ifdef USE_ONNX_RUNTIME
 bool YOLOInference::initialize_onnx(const std::string& model_path, const std::string& config_path) {
     try {
+        // Thresholds, detection cap and class names from the model's config.json, if any
+        load_config(config_path);
+        
         // Initialize ONNX Runtime
         ort_env_ = std::make_unique<Ort::Env>(ORT_LOGGING_LEVEL_WARNING, "YOLOInference");
         
-        session_options_ = std::make_unique<Ort::SessionOptions>();
-        session_options_->SetIntraOpNumThreads(4);
-        session_options_->SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
-        
-        // Create session  
-        ort_session_ = std::make_unique<Ort::Session>(*ort_env_, model_path.c_str(), *session_options_);
+        // Create session, from the cached optimized graph when there is one
+        ort_session_ = create_session(model_path);
         
         // Get input/output names and shapes
         Ort::AllocatorWithDefaultOptions allocator;
@@ -83,6 +132,8 @@ bool YOLOInference::initialize_onnx(const std::string& model_path, const std::st
                 if (i < input_shape_.size() - 1) std::cout << ", ";
             }
             std::cout << "]" << std::endl;
+            
+            resolve_input_size();
         }
         
         // Output info  
@@ -90,6 +141,9 @@ bool YOLOInference::initialize_onnx(const std::string& model_path, const std::st
         if (num_output_nodes > 0) {
             auto output_name = ort_session_->GetOutputNameAllocated(0, allocator);
             output_names_.push_back(std::string(output_name.get()));
+            
+            auto output_type_info = ort_session_->GetOutputTypeInfo(0);
+            output_shape_ = output_type_info.GetTensorTypeAndShapeInfo().GetShape();
             std::cout << "📊 Output: " << output_names_[0] << std::endl;
         }
         
@@ -102,6 +156,7 @@ bool YOLOInference::initialize_onnx(const std::string& model_path, const std::st
     } catch (const std::exception& e) {
         std::cerr << "❌ ONNX Runtime initialization failed: " << e.what() << std::endl;
         std::cerr << "💡 Falling back to mock detection" << std::endl;
+        model_path_.clear();
         initialized_ = true; // Enable fallback
         return true;
     }
@@ -113,124 +168,490 @@ bool YOLOInference::initialize_onnx(const std::string& model_path, const std::st
 #endif
 }
 
-std::vector<BBox> YOLOInference::detect_layout(const cv::Mat& image) {
+#ifdef USE_ONNX_RUNTIME
+void YOLOInference::configure_session_options() {
+    session_options_ = std::make_unique<Ort::SessionOptions>();
+    
+    // The session is shared, so concurrent runs from all page workers share one
+    // intra-op pool; the core budget in main sizes it accordingly
+    int intra_threads = options_.intra_op_threads;
+    if (intra_threads <= 0) {
+        intra_threads = static_cast<int>(std::min(4u, std::max(1u, std::thread::hardware_concurrency())));
+    }
+    session_options_->SetIntraOpNumThreads(intra_threads);
+    
+    if (options_.parallel_execution) {
+        session_options_->SetExecutionMode(ExecutionMode::ORT_PARALLEL);
+        if (options_.inter_op_threads > 0) {
+            session_options_->SetInterOpNumThreads(options_.inter_op_threads);
+        }
+    } else {
+        session_options_->SetExecutionMode(ExecutionMode::ORT_SEQUENTIAL);
+    }
+    
+    const char* spinning = options_.allow_spinning ? "1" : "0";
+    session_options_->AddConfigEntry("session.intra_op.allow_spinning", spinning);
+    session_options_->AddConfigEntry("session.inter_op.allow_spinning", spinning);
+    
+    if (options_.cpu_mem_arena) {
+        session_options_->EnableCpuMemArena();
+    } else {
+        session_options_->DisableCpuMemArena();
+    }
+    
+    session_options_->SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
+    
+    std::cout << "🧵 ORT: " << intra_threads << " intra-op thread(s), "
+              << (options_.parallel_execution ? "parallel" : "sequential") << " execution, spinning "
+              << (options_.allow_spinning ? "on" : "off") << ", memory arena "
+              << (options_.cpu_mem_arena ? "on" : "off") << std::endl;
+}
+
+std::unique_ptr<Ort::Session> YOLOInference::create_session(const std::string& model_path) {
+    std::string cache_path = optimized_model_cache_path(model_path);
+    
+    if (!cache_path.empty() && utils::file_exists(cache_path)) {
+        try {
+            // The cached graph is already optimized, so optimization is skipped on load
+            configure_session_options();
+            session_options_->SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+            auto session = std::make_unique<Ort::Session>(*ort_env_, cache_path.c_str(), *session_options_);
+            std::cout << "⚡ Loaded optimized model from cache: " << cache_path << std::endl;
+            return session;
+        } catch (const std::exception& e) {
+            std::cerr << "⚠️ Cached optimized model unusable (" << e.what() << "), rebuilding" << std::endl;
+            std::error_code ec;
+            std::filesystem::remove(cache_path, ec);
+        }
+    }
+    
+    if (!cache_path.empty()) {
+        // ORT writes the optimized graph while creating the session; it goes to a
+        // per-process temp file and is renamed into place, so concurrent starts
+        // never see a partial file
+        std::string tmp_path = cache_path + ".tmp." + std::to_string(getpid());
+        try {
+            configure_session_options();
+            session_options_->SetOptimizedModelFilePath(tmp_path.c_str());
+            auto session = std::make_unique<Ort::Session>(*ort_env_, model_path.c_str(), *session_options_);
+            
+            std::error_code ec;
+            std::filesystem::rename(tmp_path, cache_path, ec);
+            if (ec) {
+                std::cerr << "⚠️ Could not cache optimized model: " << ec.message() << std::endl;
+                std::filesystem::remove(tmp_path, ec);
+            } else {
+                std::cout << "💾 Cached optimized model: " << cache_path << std::endl;
+            }
+            return session;
+        } catch (const std::exception& e) {
+            std::cerr << "⚠️ Optimized model caching failed (" << e.what() << "), loading without cache" << std::endl;
+            std::error_code ec;
+            std::filesystem::remove(tmp_path, ec);
+        }
+    }
+    
+    configure_session_options();
+    return std::make_unique<Ort::Session>(*ort_env_, model_path.c_str(), *session_options_);
+}
+
+std::string YOLOInference::optimized_model_cache_path(const std::string& model_path) const {
+    if (!options_.optimized_model_cache) {
+        return "";
+    }
+    
+    std::filesystem::path model(model_path);
+    std::filesystem::path dir = options_.model_cache_dir.empty()
+        ? model.parent_path() / "ort_cache"
+        : std::filesystem::path(options_.model_cache_dir);
+    
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "⚠️ Optimized model cache disabled, cannot create " << dir.string() << ": " << ec.message() << std::endl;
+        return "";
+    }
+    
+    std::string model_hash = utils::hash_file(model_path);
+    if (model_hash.empty()) {
+        return "";
+    }
+    
+    // Keyed by model contents, ORT version and the options that shape the graph
+    std::string key = model.stem().string() + "-" + model_hash +
+                      "-ort" + OrtGetApiBase()->GetVersionString() +
+                      "-opt" + std::to_string(static_cast<int>(GraphOptimizationLevel::ORT_ENABLE_EXTENDED));
+    return (dir / (key + ".onnx")).string();
+}
+
+void YOLOInference::resolve_input_size() {
+    // A model with fixed spatial dimensions dictates the input size; a dynamic
+    // one runs at the requested size (or the 1024 the default model expects)
+    bool fixed_size = input_shape_.size() == 4 && input_shape_[2] > 0 && input_shape_[3] > 0;
+    if (fixed_size) {
+        cv::Size declared(static_cast<int>(input_shape_[3]), static_cast<int>(input_shape_[2]));
+        if (options_.input_size > 0 && declared != cv::Size(options_.input_size, options_.input_size)) {
+            std::cout << "⚠️ Model input is fixed at " << declared.width << "x" << declared.height
+                      << ", ignoring requested detector size " << options_.input_size << std::endl;
+        }
+        input_size_ = declared;
+    } else {
+        int size = options_.input_size > 0 ? options_.input_size : 1024;
+        // YOLO strides need the input to be a multiple of 32
+        int aligned = std::max(32, (size + 31) / 32 * 32);
+        if (aligned != size) {
+            std::cout << "⚠️ Detector size " << size << " rounded up to " << aligned << std::endl;
+        }
+        input_size_ = cv::Size(aligned, aligned);
+    }
+    std::cout << "📐 Detector input size: " << input_size_.width << "x" << input_size_.height << std::endl;
+}
+#endif
+
+std::unique_ptr<YOLOInference::RunState> YOLOInference::create_run_state(const std::string& tag) const {
+    auto state = std::make_unique<RunState>();
+#ifdef USE_ONNX_RUNTIME
+    if (!tag.empty()) {
+        state->run_options.SetRunTag(tag.c_str());
+    }
+#endif
+    return state;
+}
+
+#ifdef USE_ONNX_RUNTIME
+void YOLOInference::bind_buffers(RunState& state, size_t batch) const {
+    if (state.binding && state.bound_batch == batch) {
+        return;
+    }
+    
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(
+        OrtArenaAllocator, OrtMemTypeDefault);
+    
+    // Input tensor over the worker's persistent buffer
+    std::vector<int64_t> input_shape = {static_cast<int64_t>(batch), 3, input_size_.height, input_size_.width};
+    state.input_buffer.assign(batch * 3 * input_size_.area(), 0.0f);
+    state.input_tensor = Ort::Value::CreateTensor<float>(
+        memory_info, state.input_buffer.data(), state.input_buffer.size(),
+        input_shape.data(), input_shape.size());
+    
+    state.binding = std::make_unique<Ort::IoBinding>(*ort_session_);
+    state.binding->BindInput(input_names_[0].c_str(), state.input_tensor);
+    
+    // Preallocate the output when its shape is fully known for this batch size,
+    // otherwise let ORT allocate it on each run
+    std::vector<int64_t> output_shape = output_shape_;
+    bool static_output = output_shape.size() == 3;
+    if (static_output) {
+        output_shape[0] = static_cast<int64_t>(batch);
+        static_output = output_shape[1] > 0 && output_shape[2] > 0;
+    }
+    
+    if (static_output) {
+        state.output_shape = output_shape;
+        state.output_buffer.assign(static_cast<size_t>(output_shape[0] * output_shape[1] * output_shape[2]), 0.0f);
+        state.output_tensor = Ort::Value::CreateTensor<float>(
+            memory_info, state.output_buffer.data(), state.output_buffer.size(),
+            output_shape.data(), output_shape.size());
+        state.binding->BindOutput(output_names_[0].c_str(), state.output_tensor);
+    } else {
+        state.output_shape.clear();
+        state.output_buffer.clear();
+        state.output_tensor = Ort::Value(nullptr);
+        state.binding->BindOutput(output_names_[0].c_str(), memory_info);
+    }
+    
+    state.bound_batch = batch;
+}
+#endif
+
+std::vector<BBox> YOLOInference::detect_layout(const cv::Mat& image, RunState* state) {
+    // Boxes are scaled from the model input back to the image
+    return run_detection(image, 0.0f, 0.0f,
+                         static_cast<float>(image.cols) / input_size_.width,
+                         static_cast<float>(image.rows) / input_size_.height,
+                         image.size(), state);
+}
+
+std::vector<BBox> YOLOInference::detect_layout_letterboxed(const cv::Mat& model_input,
+                                                           const cv::Rect2f& content,
+                                                           const cv::Size& target_size,
+                                                           RunState* state) {
+    // Boxes are mapped from the content area of the model input to target_size
+    return run_detection(model_input, content.x, content.y,
+                         target_size.width / content.width,
+                         target_size.height / content.height,
+                         target_size, state);
+}
+
+std::vector<std::vector<BBox>> YOLOInference::detect_layout_batch(const std::vector<cv::Mat>& images,
+                                                                  RunState* state) {
+    std::vector<DetectionInput> inputs;
+    inputs.reserve(images.size());
+    for (const auto& image : images) {
+        inputs.push_back({&image, 0.0f, 0.0f,
+                          static_cast<float>(image.cols) / input_size_.width,
+                          static_cast<float>(image.rows) / input_size_.height,
+                          image.size()});
+    }
+    return run_detection_batch(inputs, state);
+}
+
+std::vector<std::vector<BBox>> YOLOInference::detect_layout_letterboxed_batch(const std::vector<cv::Mat>& model_inputs,
+                                                                              const std::vector<cv::Rect2f>& contents,
+                                                                              const std::vector<cv::Size>& target_sizes,
+                                                                              RunState* state) {
+    if (contents.size() != model_inputs.size() || target_sizes.size() != model_inputs.size()) {
+        throw std::invalid_argument("detect_layout_letterboxed_batch: mismatched input sizes");
+    }
+    
+    std::vector<DetectionInput> inputs;
+    inputs.reserve(model_inputs.size());
+    for (size_t i = 0; i < model_inputs.size(); ++i) {
+        const cv::Rect2f& content = contents[i];
+        inputs.push_back({&model_inputs[i], content.x, content.y,
+                          target_sizes[i].width / content.width,
+                          target_sizes[i].height / content.height,
+                          target_sizes[i]});
+    }
+    return run_detection_batch(inputs, state);
+}
+
+std::vector<BBox> YOLOInference::run_detection(const cv::Mat& image,
+                                               float offset_x, float offset_y,
+                                               float scale_x, float scale_y,
+                                               const cv::Size& target_size,
+                                               RunState* state) {
+    std::vector<DetectionInput> inputs = {{&image, offset_x, offset_y, scale_x, scale_y, target_size}};
+    return std::move(run_detection_batch(inputs, state).front());
+}
+
+std::vector<std::vector<BBox>> YOLOInference::run_detection_batch(const std::vector<DetectionInput>& inputs,
+                                                                  RunState* state) {
+    std::vector<std::vector<BBox>> results(inputs.size());
+    
     if (!initialized_) {
         std::cerr << "❌ YOLO inference not initialized" << std::endl;
-        return {};
+        return results;
     }
     
     // ONNX Runtime inference
 #ifdef USE_ONNX_RUNTIME
     if (ort_session_) {
-        try {
-            // Preprocess image
-            cv::Mat preprocessed = preprocess_image(image);
-            
-            // Prepare input tensor
-            std::vector<float> input_data;
-            input_data.assign((float*)preprocessed.data, 
-                            (float*)preprocessed.data + preprocessed.total());
-            
-        // Create input tensor
-        Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(
-            OrtArenaAllocator, OrtMemTypeDefault);
-        
-        std::vector<int64_t> input_shape = {1, 3, 1024, 1024}; // Updated for 1024x1024 input
-        Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-            memory_info, input_data.data(), input_data.size(),
-            input_shape.data(), input_shape.size());            // Run inference
-            std::vector<const char*> input_names_cstr;
-            std::vector<const char*> output_names_cstr;
-            
-            for (const auto& name : input_names_) {
-                input_names_cstr.push_back(name.c_str());
-            }
-            for (const auto& name : output_names_) {
-                output_names_cstr.push_back(name.c_str());
-            }
-            
-            auto output_tensors = ort_session_->Run(
-                Ort::RunOptions{nullptr},
-                input_names_cstr.data(), &input_tensor, 1,
-                output_names_cstr.data(), output_names_cstr.size());
-            
-            // Process output
-            float* output_data = output_tensors[0].GetTensorMutableData<float>();
-            auto output_shape = output_tensors[0].GetTensorTypeAndShapeInfo().GetShape();
-            
-            std::cout << "🔍 YOLO ONNX inference completed, processing " << output_shape[1] << " detections" << std::endl;
-            std::cout << "📐 Output shape: [";
-            for (size_t i = 0; i < output_shape.size(); ++i) {
-                std::cout << output_shape[i];
-                if (i < output_shape.size() - 1) std::cout << ", ";
-            }
-            std::cout << "]" << std::endl;
+        std::unique_ptr<RunState> local_state;
+        if (!state) {
+            local_state = create_run_state();
+            state = local_state.get();
+        }
+        
+        // A model exported with a fixed batch dimension takes exactly that many
+        // images per run (a batch-1 export degrades to one run per image); a
+        // dynamic batch dimension takes the whole request in one run
+        bool fixed_batch = input_shape_.size() == 4 && input_shape_[0] > 0;
+        size_t max_batch = fixed_batch ? static_cast<size_t>(input_shape_[0]) : inputs.size();
+        
+        for (size_t start = 0; start < inputs.size(); start += max_batch) {
+            size_t count = std::min(max_batch, inputs.size() - start);
+            size_t batch = fixed_batch ? max_batch : count;
             
-            // Debug: show first detection raw values
-            if (output_shape[1] > 0 && output_shape[2] > 4) {
-                std::cout << "🔬 First detection raw: [";
-                for (int i = 0; i < std::min(8, (int)output_shape[2]); ++i) {
-                    std::cout << output_data[i] << (i < 7 ? ", " : "");
+            try {
+                // Pack the preprocessed images into the worker's bound input
+                // tensor; unused slots of a fixed-size batch are ignored
+                bind_buffers(*state, batch);
+                const size_t image_size = 3 * static_cast<size_t>(input_size_.area());
+                for (size_t k = 0; k < count; ++k) {
+                    preprocess_image(*inputs[start + k].image, state->input_buffer.data() + k * image_size);
                 }
-                std::cout << "...]" << std::endl;
-            }
-            
-            // Convert output to vector
-            size_t output_size = 1;
-            for (auto dim : output_shape) output_size *= dim;
-            std::vector<float> output_vec(output_data, output_data + output_size);
-            
-            // Calculate scale factors
-            float scale_x = static_cast<float>(image.cols) / 1024.0f;
-            float scale_y = static_cast<float>(image.rows) / 1024.0f;
-            
-            // Postprocess detections - YOLO11 format: [batch, 84, 8400]
-            // Where 84 = 4 bbox coords + 80 class confidences
-            auto detections = postprocess_yolo11_detections(output_vec, 
-                                                          static_cast<int>(output_shape[1]),  // num_attributes (84)
-                                                          static_cast<int>(output_shape[2]),  // num_detections (8400)
-                                                          scale_x, scale_y);
-            
-            std::cout << "🎯 YOLO ONNX detected " << detections.size() << " layout regions!" << std::endl;
-            
-            // Debug: show first few detections
-            for (size_t i = 0; i < std::min(detections.size(), (size_t)3); ++i) {
-                const auto& det = detections[i];
-                std::cout << "  Region " << i << ": " << det.label 
-                         << " [" << det.x1 << "," << det.y1 << "," << det.x2 << "," << det.y2 
-                         << "] conf=" << det.confidence << std::endl;
+                
+                // Run inference
+                ort_session_->Run(state->run_options, *state->binding);
+                
+                // Read the output in place: from the preallocated buffer, or from
+                // the tensor ORT allocated when the output shape is not static
+                const float* output_data = state->output_buffer.data();
+                std::vector<int64_t> output_shape = state->output_shape;
+                std::vector<Ort::Value> allocated_outputs;
+                if (!state->output_tensor) {
+                    allocated_outputs = state->binding->GetOutputValues();
+                    output_data = allocated_outputs[0].GetTensorData<float>();
+                    output_shape = allocated_outputs[0].GetTensorTypeAndShapeInfo().GetShape();
+                }
+                
+                if (output_shape.size() != 3 || output_shape[0] < static_cast<int64_t>(count)) {
+                    throw std::runtime_error("unexpected output shape for batch of " + std::to_string(batch));
+                }
+                
+                std::cout << "🔍 YOLO ONNX inference completed for " << count << " image(s), processing "
+                          << output_shape[1] << " detections" << std::endl;
+                std::cout << "📐 Output shape: [";
+                for (size_t i = 0; i < output_shape.size(); ++i) {
+                    std::cout << output_shape[i];
+                    if (i < output_shape.size() - 1) std::cout << ", ";
+                }
+                std::cout << "]" << std::endl;
+                
+                // Split the [batch, attributes, detections] output back per image
+                size_t per_image = static_cast<size_t>(output_shape[1] * output_shape[2]);
+                for (size_t k = 0; k < count; ++k) {
+                    const DetectionInput& input = inputs[start + k];
+                    // Postprocess detections - YOLO11 format: [batch, 84, 8400]
+                    // Where 84 = 4 bbox coords + 80 class confidences
+                    auto detections = postprocess_yolo11_detections(output_data + k * per_image,
+                                                                  static_cast<int>(output_shape[1]),  // num_attributes (84)
+                                                                  static_cast<int>(output_shape[2]),  // num_detections (8400)
+                                                                  input.offset_x, input.offset_y,
+                                                                  input.scale_x, input.scale_y);
+                    
+                    std::cout << "🎯 YOLO ONNX detected " << detections.size() << " layout regions!" << std::endl;
+                    
+                    // Debug: show first few detections
+                    for (size_t i = 0; i < std::min(detections.size(), (size_t)3); ++i) {
+                        const auto& det = detections[i];
+                        std::cout << "  Region " << i << ": " << det.label 
+                                 << " [" << det.x1 << "," << det.y1 << "," << det.x2 << "," << det.y2 
+                                 << "] conf=" << det.confidence << std::endl;
+                    }
+                    
+                    results[start + k] = std::move(detections);
+                }
+                
+            } catch (const std::exception& e) {
+                std::cerr << "❌ YOLO ONNX inference error: " << e.what() << std::endl;
+                if (count > 1) {
+                    std::cerr << "💡 Retrying batch one image at a time" << std::endl;
+                    for (size_t k = 0; k < count; ++k) {
+                        const DetectionInput& input = inputs[start + k];
+                        results[start + k] = run_detection(*input.image, input.offset_x, input.offset_y,
+                                                           input.scale_x, input.scale_y,
+                                                           input.target_size, state);
+                    }
+                    continue;
+                }
+                std::cerr << "💡 Falling back to mock detection" << std::endl;
+                for (size_t k = 0; k < count; ++k) {
+                    results[start + k] = create_fallback_layout(inputs[start + k].target_size);
+                }
+                state->fallback_images += count;
             }
-            
-            return detections;
-            
-        } catch (const std::exception& e) {
-            std::cerr << "❌ YOLO ONNX inference error: " << e.what() << std::endl;
-            std::cerr << "💡 Falling back to mock detection" << std::endl;
-            return create_fallback_layout(image);
         }
+        return results;
     }
 #endif
     
     std::cout << "🔄 No YOLO model loaded, using fallback detection" << std::endl;
-    return create_fallback_layout(image);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        results[i] = create_fallback_layout(inputs[i].target_size);
+    }
+    return results;
 }
 
-cv::Mat YOLOInference::preprocess_image(const cv::Mat& image) {
-    cv::Mat resized, normalized, blob;
-    
-    // Resize to model input size (1024x1024 for current model)
-    cv::resize(image, resized, cv::Size(1024, 1024));
+void YOLOInference::preprocess_image(const cv::Mat& image, float* dst) {
+    // The resize kernel below assumes at least one source pixel; an empty page
+    // raster goes to the caller's fallback instead
+    if (image.empty()) {
+        throw std::invalid_argument("preprocess_image: empty image");
+    }
     
-    // Convert BGR to RGB if needed
-    cv::cvtColor(resized, resized, cv::COLOR_BGR2RGB);
+    const int dst_w = input_size_.width;
+    const int dst_h = input_size_.height;
+    const size_t plane_size = static_cast<size_t>(dst_w) * dst_h;
+    const float norm = 1.0f / 255.0f;
+    
+    // Pages are rendered as 8-bit BGR; anything else is converted first
+    cv::Mat bgr = image;
+    if (bgr.channels() == 1) {
+        cv::cvtColor(image, bgr, cv::COLOR_GRAY2BGR);
+    } else if (bgr.channels() == 4) {
+        cv::cvtColor(image, bgr, cv::COLOR_BGRA2BGR);
+    }
+    if (bgr.depth() != CV_8U) {
+        bgr.convertTo(bgr, CV_8U);
+    }
     
-    // Normalize to [0,1]
-    resized.convertTo(normalized, CV_32F, 1.0/255.0);
+    // The model has always been fed B, G, R planes: the old pipeline swapped to
+    // RGB with cvtColor and then back again with blobFromImage(swapRB=true)
+    float* plane0 = dst;
+    float* plane1 = dst + plane_size;
+    float* plane2 = dst + 2 * plane_size;
+    
+    // Pages rendered at the model input size are only normalized and split
+    if (bgr.cols == dst_w && bgr.rows == dst_h) {
+        for (int y = 0; y < dst_h; ++y) {
+            const uchar* src = bgr.ptr<uchar>(y);
+            float* out0 = plane0 + static_cast<size_t>(y) * dst_w;
+            float* out1 = plane1 + static_cast<size_t>(y) * dst_w;
+            float* out2 = plane2 + static_cast<size_t>(y) * dst_w;
+            for (int x = 0; x < dst_w; ++x) {
+                out0[x] = src[3 * x + 0] * norm;
+                out1[x] = src[3 * x + 1] * norm;
+                out2[x] = src[3 * x + 2] * norm;
+            }
+        }
+        return;
+    }
     
-    // Convert to CHW format (channels first)
-    cv::dnn::blobFromImage(normalized, blob, 1.0, cv::Size(1024, 1024), cv::Scalar(0,0,0), true, false);
+    // Bilinear resize with the same half-pixel mapping as cv::resize(INTER_LINEAR),
+    // fused with normalization and the planar split; column taps are computed once
+    const int src_w = bgr.cols;
+    const int src_h = bgr.rows;
+    const float scale_x = static_cast<float>(src_w) / dst_w;
+    const float scale_y = static_cast<float>(src_h) / dst_h;
+    
+    std::vector<int> x0_ofs(dst_w), x1_ofs(dst_w);
+    std::vector<float> x_weight(dst_w);
+    for (int x = 0; x < dst_w; ++x) {
+        float fx = (x + 0.5f) * scale_x - 0.5f;
+        int sx = static_cast<int>(std::floor(fx));
+        fx -= sx;
+        if (sx < 0) {
+            sx = 0;
+            fx = 0.0f;
+        }
+        if (sx >= src_w - 1) {
+            sx = src_w - 1;
+            fx = 0.0f;
+        }
+        x0_ofs[x] = sx * 3;
+        x1_ofs[x] = std::min(sx + 1, src_w - 1) * 3;
+        x_weight[x] = fx;
+    }
     
-    return blob;
+    for (int y = 0; y < dst_h; ++y) {
+        float fy = (y + 0.5f) * scale_y - 0.5f;
+        int sy = static_cast<int>(std::floor(fy));
+        fy -= sy;
+        if (sy < 0) {
+            sy = 0;
+            fy = 0.0f;
+        }
+        if (sy >= src_h - 1) {
+            sy = src_h - 1;
+            fy = 0.0f;
+        }
+        const uchar* row0 = bgr.ptr<uchar>(sy);
+        const uchar* row1 = bgr.ptr<uchar>(std::min(sy + 1, src_h - 1));
+        
+        float* out0 = plane0 + static_cast<size_t>(y) * dst_w;
+        float* out1 = plane1 + static_cast<size_t>(y) * dst_w;
+        float* out2 = plane2 + static_cast<size_t>(y) * dst_w;
+        for (int x = 0; x < dst_w; ++x) {
+            const uchar* a = row0 + x0_ofs[x];
+            const uchar* b = row0 + x1_ofs[x];
+            const uchar* c = row1 + x0_ofs[x];
+            const uchar* d = row1 + x1_ofs[x];
+            float wx = x_weight[x];
+            
+            float top0 = a[0] + (b[0] - a[0]) * wx;
+            float top1 = a[1] + (b[1] - a[1]) * wx;
+            float top2 = a[2] + (b[2] - a[2]) * wx;
+            float bottom0 = c[0] + (d[0] - c[0]) * wx;
+            float bottom1 = c[1] + (d[1] - c[1]) * wx;
+            float bottom2 = c[2] + (d[2] - c[2]) * wx;
+            
+            out0[x] = (top0 + (bottom0 - top0) * fy) * norm;
+            out1[x] = (top1 + (bottom1 - top1) * fy) * norm;
+            out2[x] = (top2 + (bottom2 - top2) * fy) * norm;
+        }
+    }
 }
 
 std::vector<BBox> YOLOInference::postprocess_detections(const std::vector<float>& output_data,
@@ -294,45 +715,84 @@ std::vector<BBox> YOLOInference::postprocess_detections(const std::vector<float>
 }
 
 std::vector<int> YOLOInference::nms(const std::vector<BBox>& boxes, float threshold) {
-    std::vector<int> indices(boxes.size());
-    std::iota(indices.begin(), indices.end(), 0);
+    const int n = static_cast<int>(boxes.size());
+    std::vector<int> keep;
+    if (n == 0) return keep;
     
-    // Sort by confidence (descending)
-    std::sort(indices.begin(), indices.end(), [&boxes](int a, int b) {
+    // Greedy order: descending confidence. Everything below works on ranks
+    // in this order, with the boxes copied into SoA arrays and areas computed once
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&boxes](int a, int b) {
         return boxes[a].confidence > boxes[b].confidence;
     });
     
-    std::vector<bool> suppressed(boxes.size(), false);
-    std::vector<int> keep;
+    std::vector<float> x1(n), y1(n), x2(n), y2(n), area(n);
+    std::vector<int> cls(n);
+    for (int r = 0; r < n; ++r) {
+        const BBox& box = boxes[order[r]];
+        x1[r] = box.x1;
+        y1[r] = box.y1;
+        x2[r] = box.x2;
+        y2[r] = box.y2;
+        area[r] = (box.x2 - box.x1) * (box.y2 - box.y1);
+        cls[r] = box.class_id;
+    }
+    
+    // Sweep structure: ranks sorted by class, then by top edge. Layout boxes are
+    // mostly flat lines stacked down the page, so sweeping on y skips most pairs
+    std::vector<int> by_y(n);
+    std::iota(by_y.begin(), by_y.end(), 0);
+    std::sort(by_y.begin(), by_y.end(), [&](int a, int b) {
+        return cls[a] != cls[b] ? cls[a] < cls[b] : y1[a] < y1[b];
+    });
     
-    for (size_t i = 0; i < indices.size(); ++i) {
-        int idx_i = indices[i];
-        if (suppressed[idx_i]) continue;
+    struct ClassRange { int begin, end; float max_height; };
+    std::vector<ClassRange> ranges;
+    std::vector<int> range_of(n);
+    for (int k = 0; k < n; ++k) {
+        int r = by_y[k];
+        if (ranges.empty() || cls[by_y[ranges.back().begin]] != cls[r]) {
+            ranges.push_back({k, k, 0.0f});
+        }
+        ClassRange& range = ranges.back();
+        range.end = k + 1;
+        range.max_height = std::max(range.max_height, y2[r] - y1[r]);
+        range_of[r] = static_cast<int>(ranges.size()) - 1;
+    }
+    
+    std::vector<char> suppressed(n, 0);
+    for (int r = 0; r < n; ++r) {
+        if (suppressed[r]) continue;
+        
+        keep.push_back(order[r]);
+        if (max_detections_ > 0 && static_cast<int>(keep.size()) >= max_detections_) break;
         
-        keep.push_back(idx_i);
+        // Only boxes of the same class whose top edge lies in
+        // [y1 - max_height, y2) can overlap this one
+        const ClassRange& range = ranges[range_of[r]];
+        auto first = std::lower_bound(by_y.begin() + range.begin, by_y.begin() + range.end,
+                                      y1[r] - range.max_height,
+                                      [&](int k, float v) { return y1[k] < v; });
+        auto last = std::lower_bound(first, by_y.begin() + range.end, y2[r],
+                                     [&](int k, float v) { return y1[k] < v; });
         
-        for (size_t j = i + 1; j < indices.size(); ++j) {
-            int idx_j = indices[j];
-            if (suppressed[idx_j]) continue;
+        for (auto it = first; it != last; ++it) {
+            int j = *it;
+            if (j <= r || suppressed[j]) continue;
             
             // Calculate IoU
-            const auto& box_i = boxes[idx_i];
-            const auto& box_j = boxes[idx_j];
+            float ix1 = std::max(x1[r], x1[j]);
+            float iy1 = std::max(y1[r], y1[j]);
+            float ix2 = std::min(x2[r], x2[j]);
+            float iy2 = std::min(y2[r], y2[j]);
             
-            float x1 = std::max(box_i.x1, box_j.x1);
-            float y1 = std::max(box_i.y1, box_j.y1);
-            float x2 = std::min(box_i.x2, box_j.x2);
-            float y2 = std::min(box_i.y2, box_j.y2);
+            float intersection = std::max(0.0f, ix2 - ix1) * std::max(0.0f, iy2 - iy1);
+            float union_area = area[r] + area[j] - intersection;
+            if (union_area <= 0.0f) continue;
             
-            float intersection = std::max(0.0f, x2 - x1) * std::max(0.0f, y2 - y1);
-            float area_i = (box_i.x2 - box_i.x1) * (box_i.y2 - box_i.y1);
-            float area_j = (box_j.x2 - box_j.x1) * (box_j.y2 - box_j.y1);
-            float union_area = area_i + area_j - intersection;
-            
-            float iou = intersection / union_area;
-            
-            if (iou > threshold) {
-                suppressed[idx_j] = true;
+            if (intersection / union_area > threshold) {
+                suppressed[j] = 1;
             }
         }
     }
@@ -340,51 +800,58 @@ std::vector<int> YOLOInference::nms(const std::vector<BBox>& boxes, float thresh
     return keep;
 }
 
-std::vector<BBox> YOLOInference::postprocess_yolo11_detections(const std::vector<float>& output_data,
+std::vector<BBox> YOLOInference::postprocess_yolo11_detections(const float* output_data,
                                                              int num_attributes, int num_detections,
+                                                             float offset_x, float offset_y,
                                                              float scale_x, float scale_y) {
     std::vector<BBox> boxes;
     
     // Document layout YOLO output format: [batch, 15, 8400]
     // 15 attributes: [x_center, y_center, width, height, class0_conf, class1_conf, ..., class10_conf]
     // 8400 detections from different feature map scales
+    // The layout is attribute-major, so each attribute is a contiguous plane
     
     // Document layout classes (typical PubLayNet/DocLayNet classes)
-    const int num_classes = 11; // 15 - 4 = 11 classes (4 bbox coords + 11 class confidences)
-    
-    // Debug: check confidence distribution with new format
-    std::vector<float> conf_values;
-    for (int i = 0; i < std::min(100, num_detections); ++i) {
-        for (int c = 0; c < num_classes; ++c) {
-            float raw_conf = output_data[(4 + c) * num_detections + i];
-            // Document models might already have sigmoid applied
-            float conf = raw_conf > 1.0f ? 1.0f / (1.0f + std::exp(-raw_conf)) : raw_conf;
-            if (conf > 0.1f) conf_values.push_back(conf);
-        }
+    const int num_classes = num_attributes - 4; // 15 - 4 = 11 classes (4 bbox coords + 11 class confidences)
+    if (num_classes <= 0 || num_detections <= 0) {
+        return boxes;
     }
-    if (!conf_values.empty()) {
-        std::sort(conf_values.begin(), conf_values.end(), std::greater<float>());
-        std::cout << "🔬 Top confidences: ";
-        for (int i = 0; i < std::min(5, (int)conf_values.size()); ++i) {
-            std::cout << conf_values[i] << " ";
+    
+    // Document models might already have sigmoid applied: raw scores above 1
+    // are logits and decode through sigmoid, anything else is used as is. With
+    // a threshold <= 1 no score below the threshold can decode above it, so the
+    // threshold itself gates the raw maximum
+    const float raw_gate = conf_threshold_ <= 1.0f ? conf_threshold_ : conf_logit_;
+    
+    // Pass 1: per-anchor maximum raw class score, scanning class planes contiguously
+    std::vector<float> max_raw(output_data + 4 * static_cast<size_t>(num_detections),
+                               output_data + 5 * static_cast<size_t>(num_detections));
+    for (int c = 1; c < num_classes; ++c) {
+        const float* plane = output_data + static_cast<size_t>(4 + c) * num_detections;
+        for (int i = 0; i < num_detections; ++i) {
+            max_raw[i] = std::max(max_raw[i], plane[i]);
         }
-        std::cout << "| threshold=" << conf_threshold_ << std::endl;
     }
     
+    // Pass 2: exact decode only for anchors that can pass the threshold
+    const float* x_plane = output_data;
+    const float* y_plane = output_data + num_detections;
+    const float* w_plane = output_data + 2 * static_cast<size_t>(num_detections);
+    const float* h_plane = output_data + 3 * static_cast<size_t>(num_detections);
+    
     for (int i = 0; i < num_detections; ++i) {
-        // Extract bbox coordinates (center format) - first 4 attributes
-        float x_center = output_data[0 * num_detections + i];  // attribute 0, detection i
-        float y_center = output_data[1 * num_detections + i];  // attribute 1, detection i
-        float width = output_data[2 * num_detections + i];     // attribute 2, detection i
-        float height = output_data[3 * num_detections + i];    // attribute 3, detection i
+        if (max_raw[i] < raw_gate) continue;
         
-        // Find best class - attributes 4 to 14 are class confidences (11 classes)
+        // Best class among scores that clear the threshold; the comparison is done
+        // in raw space and exp is only taken for the logits that pass
         float max_conf = 0.0f;
         int best_class = -1;
         
         for (int c = 0; c < num_classes; ++c) {
-            float raw_conf = output_data[(4 + c) * num_detections + i];
-            // Document models might already have sigmoid applied, check if > 1
+            float raw_conf = output_data[static_cast<size_t>(4 + c) * num_detections + i];
+            bool passes = raw_conf > 1.0f ? raw_conf >= conf_logit_ : raw_conf >= conf_threshold_;
+            if (!passes) continue;
+            
             float conf = raw_conf > 1.0f ? 1.0f / (1.0f + std::exp(-raw_conf)) : raw_conf;
             if (conf > max_conf) {
                 max_conf = conf;
@@ -392,15 +859,20 @@ std::vector<BBox> YOLOInference::postprocess_yolo11_detections(const std::vector
             }
         }
         
-        // Filter by confidence threshold
-        if (max_conf < conf_threshold_) continue;
+        if (best_class < 0) continue;
+        
+        // Extract bbox coordinates (center format) - first 4 attributes
+        float x_center = x_plane[i];
+        float y_center = y_plane[i];
+        float width = w_plane[i];
+        float height = h_plane[i];
         
         // Convert to corner format and scale back to original image
         BBox bbox;
-        bbox.x1 = (x_center - width / 2.0f) * scale_x;
-        bbox.y1 = (y_center - height / 2.0f) * scale_y;
-        bbox.x2 = (x_center + width / 2.0f) * scale_x;
-        bbox.y2 = (y_center + height / 2.0f) * scale_y;
+        bbox.x1 = (x_center - width / 2.0f - offset_x) * scale_x;
+        bbox.y1 = (y_center - height / 2.0f - offset_y) * scale_y;
+        bbox.x2 = (x_center + width / 2.0f - offset_x) * scale_x;
+        bbox.y2 = (y_center + height / 2.0f - offset_y) * scale_y;
         bbox.confidence = max_conf;
         bbox.class_id = best_class;
         
@@ -457,11 +929,11 @@ std::string YOLOInference::map_doclayout_to_class(int class_id) {
     }
 }
 
-std::vector<BBox> YOLOInference::create_fallback_layout(const cv::Mat& image) {
+std::vector<BBox> YOLOInference::create_fallback_layout(const cv::Size& image_size) {
     std::vector<BBox> results;
     
-    int height = image.rows;
-    int width = image.cols;
+    int height = image_size.height;
+    int width = image_size.width;
     
     // Mock layout detection (same as before)
     results.push_back({0.1f * width, 0.05f * height, 0.9f * width, 0.15f * height, 
@@ -503,13 +975,17 @@ bool YOLOInference::load_config(const std::string& config_path) {
         config_file >> config;
         
         if (config.contains("confidence_threshold")) {
-            conf_threshold_ = config["confidence_threshold"];
+            set_conf_threshold(config["confidence_threshold"].get<float>());
         }
         
         if (config.contains("nms_threshold")) {
             nms_threshold_ = config["nms_threshold"];
         }
         
+        if (config.contains("max_detections")) {
+            set_max_detections(config["max_detections"].get<int>());
+        }
+        
         if (config.contains("class_names")) {
             class_names_.clear();
             for (const auto& name : config["class_names"]) {
@@ -519,6 +995,7 @@ bool YOLOInference::load_config(const std::string& config_path) {
         
         std::cout << "✅ Config loaded: conf=" << conf_threshold_ 
                   << ", nms=" << nms_threshold_ 
+                  << ", max_detections=" << max_detections_
                   << ", classes=" << class_names_.size() << std::endl;
         
         return true;
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <algorithm>
 #include "common_types.h"
 
 // ONNX Runtime headers
@@ -13,20 +14,77 @@
 
 class YOLOInference {
 public:
-    YOLOInference();
+    explicit YOLOInference(const DetectorOptions& options = DetectorOptions());
     ~YOLOInference();
     
+    // Per-worker inference state. Session::Run is thread-safe, but per-call
+    // data must not be shared between page workers running concurrently.
+    struct RunState {
+#ifdef USE_ONNX_RUNTIME
+        Ort::RunOptions run_options;
+        
+        // Input and output tensors over persistent buffers, bound once and
+        // reused for every run with the same batch size
+        std::unique_ptr<Ort::IoBinding> binding;
+        std::vector<float> input_buffer;
+        std::vector<float> output_buffer;
+        std::vector<int64_t> output_shape;
+        Ort::Value input_tensor{nullptr};
+        Ort::Value output_tensor{nullptr};  // Null when ORT allocates the output
+        size_t bound_batch = 0;
+#endif
+        // Images answered with the mock layout because inference failed; callers
+        // compare it before and after a run to tell real detections from filler
+        size_t fallback_images = 0;
+    };
+    
     // Initialize with ONNX model
     bool initialize(const std::string& model_dir);
     
-    // Detect layout regions in image
-    std::vector<BBox> detect_layout(const cv::Mat& image);
+    // Create run state for one worker thread
+    std::unique_ptr<RunState> create_run_state(const std::string& tag = "") const;
+    
+    // Detect layout regions in image (state may be null for single-threaded use)
+    std::vector<BBox> detect_layout(const cv::Mat& image, RunState* state = nullptr);
+    
+    // Detect on an image that already has the model input size, with the page
+    // letterboxed into the content rectangle. Boxes are returned in a
+    // target_size coordinate space covering the content area.
+    std::vector<BBox> detect_layout_letterboxed(const cv::Mat& model_input,
+                                                const cv::Rect2f& content,
+                                                const cv::Size& target_size,
+                                                RunState* state = nullptr);
+    
+    // Batched variants: all images go through the model in as few runs as the
+    // model's batch dimension allows, and results come back in input order
+    std::vector<std::vector<BBox>> detect_layout_batch(const std::vector<cv::Mat>& images,
+                                                       RunState* state = nullptr);
+    std::vector<std::vector<BBox>> detect_layout_letterboxed_batch(const std::vector<cv::Mat>& model_inputs,
+                                                                   const std::vector<cv::Rect2f>& contents,
+                                                                   const std::vector<cv::Size>& target_sizes,
+                                                                   RunState* state = nullptr);
+    
+    // Model input size pages should be rendered at for detect_layout_letterboxed
+    cv::Size input_size() const { return input_size_; }
+    
+    // Cap on regions kept per image after NMS, highest confidence first (0 = no cap)
+    void set_max_detections(int max_detections) { max_detections_ = std::max(0, max_detections); }
+    int max_detections() const { return max_detections_; }
+    float conf_threshold() const { return conf_threshold_; }
+    float nms_threshold() const { return nms_threshold_; }
+    const std::vector<std::string>& class_names() const { return class_names_; }
+    
+    // Path of the loaded ONNX model (empty when running the fallback)
+    const std::string& model_path() const { return model_path_; }
     
     // Check if YOLO model is available
     bool is_initialized() const { return initialized_; }
     
 private:
     bool initialized_;
+    DetectorOptions options_;
+    std::string model_path_;
+    cv::Size input_size_;  // Resolved from the model's input shape and options_
     
 #ifdef USE_ONNX_RUNTIME
     std::unique_ptr<Ort::Env> ort_env_;
@@ -36,23 +94,51 @@ private:
     std::vector<std::string> input_names_;
     std::vector<std::string> output_names_;
     std::vector<int64_t> input_shape_;
+    std::vector<int64_t> output_shape_;
+    
+    // (Re)bind the state's persistent tensors for a batch size
+    void bind_buffers(RunState& state, size_t batch) const;
 #endif
     
+    // Only ever set through set_conf_threshold, which keeps the two in step
     float conf_threshold_;
+    float conf_logit_;  // logit(conf_threshold_), for thresholding raw scores
+    void set_conf_threshold(float threshold);
     float nms_threshold_;
+    int max_detections_;
     std::vector<std::string> class_names_;
     
-    // Preprocessing
-    cv::Mat preprocess_image(const cv::Mat& image);
+    // One image of a detection request; boxes are mapped as (v - offset) * scale
+    struct DetectionInput {
+        const cv::Mat* image;
+        float offset_x, offset_y;
+        float scale_x, scale_y;
+        cv::Size target_size;
+    };
+    
+    // Shared inference path
+    std::vector<BBox> run_detection(const cv::Mat& image,
+                                    float offset_x, float offset_y,
+                                    float scale_x, float scale_y,
+                                    const cv::Size& target_size,
+                                    RunState* state);
+    std::vector<std::vector<BBox>> run_detection_batch(const std::vector<DetectionInput>& inputs,
+                                                       RunState* state);
+    
+    // Preprocessing: resize, normalize to [0,1] and write planar CHW floats
+    // for one image straight into dst (3 x input height x input width)
+    void preprocess_image(const cv::Mat& image, float* dst);
     
     // Postprocessing  
     std::vector<BBox> postprocess_detections(const std::vector<float>& output_data,
                                            int output_width, int output_height,
                                            float scale_x, float scale_y);
     
-    // YOLO11-specific postprocessing for [batch, attributes, detections] format
-    std::vector<BBox> postprocess_yolo11_detections(const std::vector<float>& output_data,
+    // YOLO11-specific postprocessing for [batch, attributes, detections] format,
+    // reading one image's output in place
+    std::vector<BBox> postprocess_yolo11_detections(const float* output_data,
                                                    int num_attributes, int num_detections,
+                                                   float offset_x, float offset_y,
                                                    float scale_x, float scale_y);
     
     // Map COCO class ID to layout class name
@@ -61,11 +147,11 @@ private:
     // Map document layout class ID to layout class name  
     std::string map_doclayout_to_class(int class_id);
     
-    // Non-Maximum Suppression
+    // Class-aware Non-Maximum Suppression; returns kept indices by descending confidence
     std::vector<int> nms(const std::vector<BBox>& boxes, float threshold);
     
     // Fallback detection
-    std::vector<BBox> create_fallback_layout(const cv::Mat& image);
+    std::vector<BBox> create_fallback_layout(const cv::Size& image_size);
     std::vector<BBox> create_fallback_layout_detections();
     
     // Load configuration
@@ -74,6 +160,10 @@ private:
     // Initialization methods
 #ifdef USE_ONNX_RUNTIME
     bool initialize_onnx(const std::string& model_path, const std::string& config_path);
+    void configure_session_options();
+    std::unique_ptr<Ort::Session> create_session(const std::string& model_path);
+    std::string optimized_model_cache_path(const std::string& model_path) const;
+    void resolve_input_size();
 #endif
     
     // Class names mapping